@@ -0,0 +1,130 @@
+#include "evloop.h"
+#include "helper-routines.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/epoll.h>
+
+/*******************************
+ * epoll-based event dispatching
+ *******************************/
+
+#define EVBATCH 64   /* events taken per epoll_wait */
+
+struct evsrc_t {             /* one registered descriptor */
+    int fd;
+    evhandler_t *fn;
+    void *arg;
+    struct evsrc_t *next;    /* on the dead list after ev_del */
+};
+
+static int epfd = -1;
+static struct evsrc_t **srcs;   /* srcs[fd], NULL if not registered */
+static int nsrcs;
+static struct evsrc_t *dead;    /* deleted during the current batch */
+
+/* ev_init - Create the epoll set */
+void ev_init(void)
+{
+    if ((epfd = epoll_create1(EPOLL_CLOEXEC)) < 0)
+	unix_error("epoll_create1 error");
+}
+
+/*
+ * ev_add - Call fn(fd, events, arg) whenever fd has any of events
+ *    (EPOLLIN, EPOLLOUT, ...) pending. Level triggered. Returns -1
+ *    with errno set on failure; EPERM means fd cannot be polled
+ *    (e.g. a regular file).
+ */
+int ev_add(int fd, unsigned events, evhandler_t *fn, void *arg)
+{
+    struct epoll_event ev;
+    struct evsrc_t *src, **newsrcs;
+    int n;
+
+    if (fd >= nsrcs) {
+	n = nsrcs ? nsrcs : 16;
+	while (n <= fd)
+	    n *= 2;
+	if ((newsrcs = (struct evsrc_t **)realloc(srcs, n * sizeof(struct evsrc_t *))) == NULL)
+	    return -1;
+	srcs = newsrcs;
+	while (nsrcs < n)
+	    srcs[nsrcs++] = NULL;
+    }
+    if ((src = (struct evsrc_t *)malloc(sizeof(struct evsrc_t))) == NULL)
+	return -1;
+    src->fd = fd;
+    src->fn = fn;
+    src->arg = arg;
+    src->next = NULL;
+
+    ev.events = events;
+    ev.data.ptr = src;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+	free(src);
+	return -1;
+    }
+    srcs[fd] = src;
+    return 0;
+}
+
+/*
+ * ev_mod - Change the events fd is watched for; with EPOLLONESHOT,
+ *    this is how it is re-armed after firing
+ */
+int ev_mod(int fd, unsigned events)
+{
+    struct epoll_event ev;
+
+    if (fd < 0 || fd >= nsrcs || srcs[fd] == NULL)
+	return -1;
+    ev.events = events;
+    ev.data.ptr = srcs[fd];
+    return epoll_ctl(epfd, EPOLL_CTL_MOD, fd, &ev);
+}
+
+/* ev_del - Stop watching fd. Safe to call from a callback. */
+int ev_del(int fd)
+{
+    struct evsrc_t *src;
+
+    if (fd < 0 || fd >= nsrcs || (src = srcs[fd]) == NULL)
+	return -1;
+    epoll_ctl(epfd, EPOLL_CTL_DEL, fd, NULL);
+    srcs[fd] = NULL;
+    /* Later events in the same batch may still point at src */
+    src->fn = NULL;
+    src->next = dead;
+    dead = src;
+    return 0;
+}
+
+/*
+ * ev_wait - Wait up to timeout_ms (-1: forever, 0: just poll) for
+ *    events and run the callbacks of every ready descriptor. Returns
+ *    the number of events handled.
+ */
+int ev_wait(int timeout_ms)
+{
+    struct epoll_event evs[EVBATCH];
+    struct evsrc_t *src;
+    int n, i;
+
+    if ((n = epoll_wait(epfd, evs, EVBATCH, timeout_ms)) < 0) {
+	if (errno == EINTR)
+	    return 0;
+	unix_error("epoll_wait error");
+    }
+    for (i = 0; i < n; i++) {
+	src = (struct evsrc_t *)evs[i].data.ptr;
+	if (src->fn != NULL)
+	    src->fn(src->fd, evs[i].events, src->arg);
+    }
+    while ((src = dead) != NULL) {
+	dead = src->next;
+	free(src);
+    }
+    return n;
+}
@@ -0,0 +1,22 @@
+//-*-c++-*-
+#ifndef _evloop_h_
+#define _evloop_h_
+
+#include <sys/epoll.h> // EPOLLIN etc. for ev_add
+
+/*
+ * The shell's event loop: an epoll set of descriptors, each with a
+ * callback. Signals reach the shell through a signalfd in this set
+ * rather than through handlers, so everything that reacts to them
+ * runs in the main flow of control and may use stdio and the job
+ * list freely.
+ */
+typedef void evhandler_t(int fd, unsigned events, void *arg);
+
+void ev_init(void);
+int ev_add(int fd, unsigned events, evhandler_t *fn, void *arg);
+int ev_del(int fd);
+int ev_mod(int fd, unsigned events);
+int ev_wait(int timeout_ms);
+
+#endif
@@ -0,0 +1,275 @@
+#include "fastio.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
+
+/****************************************
+ * Zero-copy data movement between fds
+ ****************************************/
+
+#define CHUNK (1 << 16)   /* bytes moved per system call */
+#define BIGCHUNK (1 << 30) /* ... when nothing is staged in a pipe */
+
+/* writeall - write(2) until len bytes are out; -1 on error */
+static int writeall(int fd, const char *buf, ssize_t len)
+{
+    ssize_t n;
+
+    while (len > 0) {
+	if ((n = write(fd, buf, len)) < 0) {
+	    if (errno == EINTR)
+		continue;
+	    return -1;
+	}
+	buf += n;
+	len -= n;
+    }
+    return 0;
+}
+
+/* copyloop - Plain read/write copy from in to out */
+static int copyloop(int in, int out)
+{
+    static char buf[CHUNK];
+    ssize_t n;
+
+    while ((n = read(in, buf, sizeof(buf))) != 0) {
+	if (n < 0) {
+	    if (errno == EINTR)
+		continue;
+	    return -1;
+	}
+	if (writeall(out, buf, n) < 0)
+	    return -1;
+    }
+    return 0;
+}
+
+/*
+ * copyrange - Copy a regular file into another with copy_file_range,
+ *    which lets the filesystem share or clone extents instead of
+ *    moving the bytes at all. Returns 1 if it does not apply to this
+ *    pair (nothing copied), else 0 or -1 like fastio_cat.
+ */
+static int copyrange(int in, int out)
+{
+    ssize_t n;
+    int started = 0;
+
+    for (;;) {
+	n = copy_file_range(in, NULL, out, NULL, BIGCHUNK, 0);
+	if (n == 0)
+	    return 0;
+	if (n < 0) {
+	    if (errno == EINTR)
+		continue;
+	    /* other filesystem on an old kernel, O_APPEND output, ... */
+	    if (!started && (errno == EXDEV || errno == EINVAL || errno == EBADF ||
+			     errno == ENOSYS || errno == EOPNOTSUPP))
+		return 1;
+	    return -1;
+	}
+	started = 1;
+    }
+}
+
+/*
+ * sendfileloop - Copy a regular file to anything (a pipe, a socket,
+ *    a file) with sendfile, straight from the page cache. Returns
+ *    like copyrange.
+ */
+static int sendfileloop(int in, int out)
+{
+    ssize_t n;
+    int started = 0;
+
+    for (;;) {
+	n = sendfile(out, in, NULL, BIGCHUNK);
+	if (n == 0)
+	    return 0;
+	if (n < 0) {
+	    if (errno == EINTR)
+		continue;
+	    if (!started && (errno == EINVAL || errno == ENOSYS))
+		return 1;
+	    return -1;
+	}
+	started = 1;
+    }
+}
+
+/*
+ * fastio_cat - Copy everything from in to out without bringing the
+ *    data into user space when the kernel can help: copy_file_range
+ *    from a regular file to another, sendfile from a regular file to
+ *    anything else, splice when one side is a pipe; read/write when
+ *    none of them apply.
+ */
+int fastio_cat(int in, int out)
+{
+    struct stat ist, ost;
+    ssize_t n;
+    int rc;
+
+    if (fstat(in, &ist) == 0 && S_ISREG(ist.st_mode)) {
+	if (fstat(out, &ost) == 0 && S_ISREG(ost.st_mode) &&
+	    (rc = copyrange(in, out)) <= 0)
+	    return rc;
+	if ((rc = sendfileloop(in, out)) <= 0)
+	    return rc;
+    }
+
+    for (;;) {
+	n = splice(in, NULL, out, NULL, CHUNK, SPLICE_F_MOVE | SPLICE_F_MORE);
+	if (n == 0)
+	    return 0;
+	if (n < 0) {
+	    if (errno == EINTR)
+		continue;
+	    if (errno == EINVAL)  /* neither end is a pipe */
+		return copyloop(in, out);
+	    return -1;
+	}
+    }
+}
+
+/*
+ * fastio_tee - Copy everything from in to out and to each of files.
+ *    With pipes on both in and out, tee(2) clones the data into out
+ *    and a scratch pipe feeds the files, then the input is consumed
+ *    by splicing it to the last file (or dropping it if there is none).
+ */
+int fastio_tee(int in, int out, const int *files, int nfiles)
+{
+    int scratch[2] = { -1, -1 };
+    ssize_t n, m, k;
+    int i, rc = -1;
+
+    if (nfiles == 0)
+	return fastio_cat(in, out);
+
+    n = tee(in, out, CHUNK, 0);
+    if (n < 0 && errno == EINVAL)
+	goto slow;
+    if (pipe2(scratch, O_CLOEXEC) < 0)
+	return -1;
+
+    for (;;) {
+	if (n == 0) {
+	    rc = 0;
+	    break;
+	}
+	if (n < 0) {
+	    if (errno == EINTR) {
+		n = tee(in, out, CHUNK, 0);
+		continue;
+	    }
+	    break;
+	}
+	/* n bytes are now in out; hand the same n to every file */
+	for (i = 0; i < nfiles - 1; i++) {
+	    if ((m = tee(in, scratch[1], n, 0)) < 0)
+		goto done;
+	    while (m > 0) {
+		if ((k = splice(scratch[0], NULL, files[i], NULL, m, SPLICE_F_MOVE)) <= 0)
+		    goto done;
+		m -= k;
+	    }
+	}
+	for (m = n; m > 0; m -= k)
+	    if ((k = splice(in, NULL, files[nfiles - 1], NULL, m, SPLICE_F_MOVE)) <= 0)
+		goto done;
+	n = tee(in, out, CHUNK, 0);
+    }
+done:
+    close(scratch[0]);
+    close(scratch[1]);
+    return rc;
+
+slow:
+    {
+	static char buf[CHUNK];
+
+	while ((n = read(in, buf, sizeof(buf))) != 0) {
+	    if (n < 0) {
+		if (errno == EINTR)
+		    continue;
+		return -1;
+	    }
+	    if (writeall(out, buf, n) < 0)
+		return -1;
+	    for (i = 0; i < nfiles; i++)
+		if (writeall(files[i], buf, n) < 0)
+		    return -1;
+	}
+	return 0;
+    }
+}
+
+/*
+ * cat_main - "cat [file...]": each file ("-" or none: stdin) in turn
+ *    to stdout. Like coreutils, a file that is also the output is
+ *    refused rather than copied into itself forever.
+ */
+int cat_main(char **argv)
+{
+    static char *stdinonly[] = { (char *)"-", NULL };
+    char **files = argv[1] != NULL ? argv + 1 : stdinonly;
+    struct stat ist, ost;
+    int outreg, fd, rc = 0;
+
+    outreg = fstat(1, &ost) == 0 && S_ISREG(ost.st_mode);
+    for (; *files != NULL; files++) {
+	if (strcmp(*files, "-") == 0)
+	    fd = 0;
+	else if ((fd = open(*files, O_RDONLY | O_CLOEXEC)) < 0) {
+	    fprintf(stderr, "%s: %s: %s\n", argv[0], *files, strerror(errno));
+	    rc = 1;
+	    continue;
+	}
+	if (outreg && fstat(fd, &ist) == 0 && ist.st_dev == ost.st_dev &&
+	    ist.st_ino == ost.st_ino) {
+	    fprintf(stderr, "%s: %s: input file is output file\n", argv[0], *files);
+	    rc = 1;
+	}
+	else if (fastio_cat(fd, 1) < 0) {
+	    fprintf(stderr, "%s: %s: %s\n", argv[0], *files, strerror(errno));
+	    rc = 1;
+	}
+	if (fd != 0)
+	    close(fd);
+    }
+    return rc;
+}
+
+/* tee_main - "tee file..." stage: stdin to stdout and every file */
+int tee_main(char **argv)
+{
+    int nfiles = 0, i, rc = 0;
+    int *files;
+
+    for (i = 1; argv[i] != NULL; i++)
+	nfiles++;
+    files = (int *)malloc((nfiles + 1) * sizeof(int));
+    for (i = 0; i < nfiles; i++) {
+	files[i] = open(argv[i + 1], O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+	if (files[i] < 0) {
+	    fprintf(stderr, "%s: %s: %s\n", argv[0], argv[i + 1], strerror(errno));
+	    free(files);
+	    return 1;
+	}
+    }
+    if (fastio_tee(0, 1, files, nfiles) < 0) {
+	fprintf(stderr, "%s: %s\n", argv[0], strerror(errno));
+	rc = 1;
+    }
+    for (i = 0; i < nfiles; i++)
+	close(files[i]);
+    free(files);
+    return rc;
+}
@@ -0,0 +1,21 @@
+//-*-c++-*-
+#ifndef _fastio_h_
+#define _fastio_h_
+
+/*
+ * Data movers that keep bytes in the kernel. copy_file_range(2)
+ * copies between regular files (sharing extents where the filesystem
+ * can), sendfile(2) sends a regular file to any descriptor, splice(2)
+ * moves pages between a pipe and another descriptor and tee(2)
+ * duplicates a pipe's contents into a second pipe without consuming
+ * them. When none of them applies they fall back to read/write.
+ */
+int fastio_cat(int in, int out);
+int fastio_tee(int in, int out, const int *files, int nfiles);
+
+/* Entry points for the stages the shell runs itself (cat with only
+ * file arguments, tee in a pipeline); return exit codes */
+int cat_main(char **argv);
+int tee_main(char **argv);
+
+#endif
@@ -5,7 +5,7 @@
 /* Misc manifest constants */
 #define MAXLINE    1024   /* max line size */
 #define MAXARGS     128   /* max args on a command line */
-#define MAXJOBS      16   /* max jobs at any point in time */
+#define MAXJOBS      16   /* initial size of the job list; it grows */
 #define MAXJID    1<<16   /* max job ID */
 
 /* Global variables */
@@ -16,10 +16,17 @@
  */
 void usage(void) 
 {
-    printf("Usage: shell [-hvp]\n");
+    printf("Usage: shell [-hvpnoz] [-j <n>] [-a <policy>] [-f <file> | -c <commands>]\n");
     printf("   -h   print this message\n");
-    printf("   -v   print additional diagnostic information\n");
+    printf("   -v   print additional diagnostic information and trace events\n");
     printf("   -p   do not emit a command prompt\n");
+    printf("   -n   run echo, cat, sleep, ... as the real programs\n");
+    printf("   -o   keep background jobs' output for the output builtin\n");
+    printf("   -z   start commands from a pre-forked helper (zygote)\n");
+    printf("   -j   run at most <n> jobs at once; queue further background jobs\n");
+    printf("   -a   pin background jobs to CPUs: roundrobin, packed or none\n");
+    printf("   -f   run the commands in <file> and exit\n");
+    printf("   -c   run the commands in the string <commands> and exit\n");
     exit(1);
 }
 
@@ -76,7 +83,8 @@ void sigquit_handler(int sig)
  */
 int parseline(const char *cmdline, char **argv) 
 {
-    char array[MAXLINE]; /* holds local copy of command line */
+    static char array[MAXLINE]; /* holds local copy of command line;
+				   argv points into it after we return */
     char *buf = array;          /* ptr that traverses command line */
     char *delim;                /* points to first space delimiter */
     int argc;                   /* number of args */
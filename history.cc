@@ -0,0 +1,479 @@
+#include "history.h"
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/****************************
+ * Command history
+ ****************************/
+
+#define HDRSIZE 4096             /* header page; the ring follows */
+#define PADBIT  0x80000000u      /* in a length word: pad, not a record */
+#define INDEXLAG (1024 * 1024)   /* bytes added before the index is rebuilt */
+#define RECENT  256              /* entries !prefix scans before the index */
+
+struct hhdr_t {
+    char magic[8];               /* "TSHHIST1" */
+    unsigned long long cap;      /* bytes in the ring, a multiple of 4 */
+    unsigned long long head;     /* position of the next record */
+    unsigned long long tail;     /* position of the oldest record */
+    unsigned long long first;    /* number of the oldest entry */
+    unsigned long long next;     /* number the next entry gets */
+};
+
+int history_on = 0;
+
+static int hfd = -1;
+static struct hhdr_t *hdr;
+static char *ring;
+
+/* The prefix index: positions of the distinct lines in the ring
+ * [idxtail, idxhead), sorted by text (a hash set while it is built) */
+static unsigned long long *idx;
+static size_t nidx, idxcap;
+static unsigned long long idxhead;
+static unsigned long long idxtail;  /* no entry is older; the ring's tail
+				       may since have passed it */
+
+/* word - The 32-bit word at ring position pos */
+static inline unsigned *word(unsigned long long pos)
+{
+    return (unsigned *)(ring + pos % hdr->cap);
+}
+
+/* recsize - Bytes taken by a record of len bytes of text */
+static inline unsigned long long recsize(unsigned len)
+{
+    return 8 + ((len + 3) & ~3u);
+}
+
+/* nextrec - Position after the record or pad at pos */
+static inline unsigned long long nextrec(unsigned long long pos)
+{
+    unsigned w = *word(pos);
+
+    return pos + ((w & PADBIT) ? (w & ~PADBIT) : recsize(w));
+}
+
+/* prevrec - Position of the record or pad that ends at pos */
+static inline unsigned long long prevrec(unsigned long long pos)
+{
+    unsigned w = *word(pos - 4);
+
+    return pos - ((w & PADBIT) ? (w & ~PADBIT) : recsize(w));
+}
+
+static inline int ispad(unsigned long long pos)
+{
+    return (*word(pos) & PADBIT) != 0;
+}
+
+static inline const char *text(unsigned long long pos)
+{
+    return ring + pos % hdr->cap + 4;
+}
+
+static inline unsigned textlen(unsigned long long pos)
+{
+    return *word(pos);
+}
+
+int history_open(const char *path, size_t cap)
+{
+    struct stat st;
+    void *map;
+
+    cap &= ~(size_t)3;
+    if ((hfd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600)) < 0) {
+	printf("history: %s: %s\n", path, strerror(errno));
+	return -1;
+    }
+    flock(hfd, LOCK_EX);
+    if (fstat(hfd, &st) < 0 || (st.st_size == 0 && ftruncate(hfd, HDRSIZE + cap) < 0)) {
+	printf("history: %s: %s\n", path, strerror(errno));
+	goto fail;
+    }
+    if (st.st_size == 0)
+	st.st_size = HDRSIZE + cap;
+    if ((size_t)st.st_size <= HDRSIZE + 64 ||
+	(map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, hfd, 0)) == MAP_FAILED) {
+	printf("history: %s: cannot map it\n", path);
+	goto fail;
+    }
+    hdr = (struct hhdr_t *)map;
+    ring = (char *)map + HDRSIZE;
+    if (memcmp(hdr->magic, "TSHHIST1", 8) != 0) {
+	if (hdr->magic[0] != '\0' || hdr->head != 0) {
+	    printf("history: %s: not a tsh history file\n", path);
+	    munmap(map, st.st_size);
+	    goto fail;
+	}
+	hdr->cap = (st.st_size - HDRSIZE) & ~3ULL;  /* a new file */
+	hdr->head = hdr->tail = 0;
+	hdr->first = hdr->next = 1;
+	memcpy(hdr->magic, "TSHHIST1", 8);
+    }
+    flock(hfd, LOCK_UN);
+    history_on = 1;
+    return 0;
+
+ fail:
+    close(hfd);
+    hfd = -1;
+    return -1;
+}
+
+/* makeroom - Drop the oldest records until need more bytes fit */
+static void makeroom(unsigned long long need)
+{
+    while (hdr->head + need - hdr->tail > hdr->cap) {
+	if (!ispad(hdr->tail))
+	    hdr->first++;
+	hdr->tail = nextrec(hdr->tail);
+    }
+}
+
+/* putword - Set the word at pos */
+static inline void putword(unsigned long long pos, unsigned w)
+{
+    *word(pos) = w;
+}
+
+/*
+ * history_add - Blank lines and a repeat of the last entry are not
+ *    kept. A record that would run past the end of the ring goes at
+ *    the start, after a pad record filling the gap.
+ */
+void history_add(const char *line, size_t len)
+{
+    unsigned long long need, pad, last;
+    size_t i;
+
+    if (!history_on)
+	return;
+    if (len > 0 && line[len - 1] == '\n')
+	len--;
+    for (i = 0; i < len && isspace((unsigned char)line[i]); i++)
+	;
+    if (i == len || (need = recsize(len)) > hdr->cap / 4)
+	return;
+
+    flock(hfd, LOCK_EX);
+    if (hdr->head > hdr->tail) {
+	for (last = prevrec(hdr->head); last > hdr->tail && ispad(last); last = prevrec(last))
+	    ;
+	if (!ispad(last) && textlen(last) == len && memcmp(text(last), line, len) == 0) {
+	    flock(hfd, LOCK_UN);
+	    return;
+	}
+    }
+    if (hdr->head % hdr->cap + need > hdr->cap) {
+	pad = hdr->cap - hdr->head % hdr->cap;
+	makeroom(pad);
+	putword(hdr->head, PADBIT | pad);
+	putword(hdr->head + pad - 4, PADBIT | pad);
+	hdr->head += pad;
+    }
+    makeroom(need);
+    putword(hdr->head, len);
+    memcpy(ring + hdr->head % hdr->cap + 4, line, len);
+    putword(hdr->head + need - 4, len);
+    hdr->head += need;
+    hdr->next++;
+    flock(hfd, LOCK_UN);
+}
+
+/* textcmp - Order records by text */
+static int textcmp(const void *a, const void *b)
+{
+    unsigned long long pa = *(const unsigned long long *)a;
+    unsigned long long pb = *(const unsigned long long *)b;
+    unsigned la = textlen(pa), lb = textlen(pb);
+    int c = memcmp(text(pa), text(pb), la < lb ? la : lb);
+
+    if (c != 0)
+	return c;
+    return la < lb ? -1 : la > lb;
+}
+
+/* prefixcmp - Order of record pos against the set of lines starting
+ *    with p: <0 before them, 0 one of them, >0 after them */
+static int prefixcmp(unsigned long long pos, const char *p, size_t plen)
+{
+    unsigned len = textlen(pos);
+    int c = memcmp(text(pos), p, len < plen ? len : plen);
+
+    if (c != 0)
+	return c;
+    return len < plen ? -1 : 0;
+}
+
+/* texthash - FNV-1a of the text of record pos */
+static unsigned long long texthash(unsigned long long pos)
+{
+    const unsigned char *p = (const unsigned char *)text(pos);
+    unsigned long long h = 14695981039346656037ULL;
+    unsigned i, len = textlen(pos);
+
+    for (i = 0; i < len; i++)
+	h = (h ^ p[i]) * 1099511628211ULL;
+    return h;
+}
+
+static inline int sametext(unsigned long long a, unsigned long long b)
+{
+    return textlen(a) == textlen(b) && memcmp(text(a), text(b), textlen(a)) == 0;
+}
+
+/* setadd - Add record pos to the open-addressed set in idx[0..idxcap),
+ *    unless a line equal to it is there already. An entry is pos + 1
+ *    with the top 16 bits of the hash above it, so most mismatches are
+ *    settled without going to the ring. */
+#define SETPOS(e) (((e) & ((1ULL << 48) - 1)) - 1)
+
+static int setadd(unsigned long long pos)
+{
+    unsigned long long h = texthash(pos), e = (pos + 1) | (h & ~((1ULL << 48) - 1));
+    size_t i = h & (idxcap - 1);
+
+    for (; idx[i] != 0; i = (i + 1) & (idxcap - 1))
+	if ((idx[i] ^ e) >> 48 == 0 && sametext(SETPOS(idx[i]), pos))
+	    return 0;
+    idx[i] = e;
+    return 1;
+}
+
+/* growset - Double the set in idx */
+static int growset(void)
+{
+    unsigned long long *old = idx;
+    size_t oldcap = idxcap, i;
+
+    idxcap = idxcap ? 2 * idxcap : 4096;
+    if ((idx = (unsigned long long *)calloc(idxcap, sizeof(*idx))) == NULL) {
+	idx = old;
+	idxcap = oldcap;
+	return -1;
+    }
+    for (i = 0; i < oldcap; i++)
+	if (old[i] != 0)
+	    setadd(SETPOS(old[i]));
+    free(old);
+    return 0;
+}
+
+/*
+ * buildindex - Sort the distinct lines in the ring (the lock is held).
+ *    Walking from the newest record, a hash set drops the older copies
+ *    of each line first, so only the distinct lines (usually a small
+ *    part of a long history) are sorted.
+ */
+static void buildindex(void)
+{
+    unsigned long long pos;
+    size_t i, n = 0;
+
+    if (idx != NULL)
+	memset(idx, 0, idxcap * sizeof(*idx));
+    for (pos = hdr->head; pos > hdr->tail; ) {
+	if (ispad(pos = prevrec(pos)))
+	    continue;
+	if (2 * (n + 1) > idxcap && growset() < 0)
+	    break;		/* index what fits */
+	n += setadd(pos);
+    }
+    for (i = nidx = 0; i < idxcap; i++)
+	if (idx[i] != 0)
+	    idx[nidx++] = SETPOS(idx[i]);
+    qsort(idx, nidx, sizeof(*idx), textcmp);
+    idxhead = hdr->head;
+    idxtail = hdr->tail;
+}
+
+/* lowerbound - First index entry not before the lines starting with p */
+static size_t lowerbound(const char *p, size_t plen)
+{
+    size_t lo = 0, hi = nidx, mid;
+
+    while (lo < hi) {
+	mid = lo + (hi - lo) / 2;
+	if (prefixcmp(idx[mid], p, plen) < 0)
+	    lo = mid + 1;
+	else
+	    hi = mid;
+    }
+    return lo;
+}
+
+/* unindexed - Where the records the index does not cover start. The
+ *    entries the ring has overwritten since the index was built are
+ *    dropped first: their bytes are now other lines', which would
+ *    break the order. What is left is still in order. */
+static unsigned long long unindexed(void)
+{
+    size_t i, n;
+
+    if (idx == NULL || hdr->head - idxhead > INDEXLAG || idxhead < hdr->tail)
+	buildindex();
+    else if (idxtail < hdr->tail) {
+	for (i = n = 0; i < nidx; i++)
+	    if (idx[i] >= hdr->tail)
+		idx[n++] = idx[i];
+	nidx = n;
+	idxtail = hdr->tail;
+    }
+    return idxhead;
+}
+
+/* findprefix - Position of the newest entry starting with p, or 0 with
+ *    *found clear (the lock is held). The last RECENT entries are
+ *    looked at first, since an event mostly names something recent,
+ *    so the index is only built for the ones that reach further back. */
+static unsigned long long findprefix(const char *p, size_t plen, int *found)
+{
+    unsigned long long pos, start, best = 0;
+    size_t i, n;
+
+    *found = 1;
+    for (pos = hdr->head, n = 0; pos > hdr->tail && n < RECENT; n++)
+	if (!ispad(pos = prevrec(pos)) && prefixcmp(pos, p, plen) == 0)
+	    return pos;
+    /* anything added since the index was built is newer than all of it */
+    for (start = unindexed(); pos > start; )
+	if (!ispad(pos = prevrec(pos)) && prefixcmp(pos, p, plen) == 0)
+	    return pos;
+    *found = 0;
+    for (i = lowerbound(p, plen); i < nidx && prefixcmp(idx[i], p, plen) == 0; i++)
+	if (idx[i] >= hdr->tail && (!*found || idx[i] > best)) {
+	    best = idx[i];
+	    *found = 1;
+	}
+    return best;
+}
+
+/* findnum - Position of entry number num, or 0 with *found clear */
+static unsigned long long findnum(unsigned long long num, int *found)
+{
+    unsigned long long pos, n;
+
+    *found = 0;
+    if (num < hdr->first || num >= hdr->next)
+	return 0;
+    if (num - hdr->first < hdr->next - num) {	/* walk from the nearer end */
+	for (pos = hdr->tail, n = hdr->first; ; pos = nextrec(pos))
+	    if (!ispad(pos) && n++ == num)
+		break;
+    }
+    else {
+	for (pos = hdr->head, n = hdr->next; n > num; )
+	    if (!ispad(pos = prevrec(pos)))
+		n--;
+    }
+    *found = 1;
+    return pos;
+}
+
+char *history_expand(char *cmdline)
+{
+    static char *buf;
+    static size_t cap;
+    unsigned long long pos = 0;
+    size_t elen, rlen, tlen;
+    char *rest, *end;
+    long long n;
+    int found = 0;
+
+    if (!history_on || cmdline[0] != '!' || isspace((unsigned char)cmdline[1]) ||
+	cmdline[1] == '\0')
+	return cmdline;
+    for (rest = cmdline + 1; *rest != '\0' && !isspace((unsigned char)*rest); rest++)
+	;
+    elen = rest - cmdline;
+
+    flock(hfd, LOCK_SH);
+    if (elen == 2 && cmdline[1] == '!')
+	pos = findnum(hdr->next - 1, &found);
+    else if (isdigit((unsigned char)cmdline[1]) ||
+	     (cmdline[1] == '-' && isdigit((unsigned char)cmdline[2]))) {
+	n = strtoll(cmdline + 1, &end, 10);
+	if (end == rest)
+	    pos = findnum(n < 0 ? hdr->next + n : (unsigned long long)n, &found);
+    }
+    else
+	pos = findprefix(cmdline + 1, elen - 1, &found);
+    if (!found) {
+	flock(hfd, LOCK_UN);
+	printf("%.*s: event not found\n", (int)elen, cmdline);
+	return NULL;
+    }
+
+    tlen = textlen(pos);
+    rlen = strlen(rest);
+    if (tlen + rlen + 1 > cap) {
+	cap = 2 * (tlen + rlen + 1);
+	if ((buf = (char *)realloc(buf, cap)) == NULL) {
+	    cap = 0;
+	    flock(hfd, LOCK_UN);
+	    return NULL;
+	}
+    }
+    memcpy(buf, text(pos), tlen);
+    flock(hfd, LOCK_UN);
+    memcpy(buf + tlen, rest, rlen + 1);
+    printf("%s", buf);	/* show what is being run, as sh does */
+    return buf;
+}
+
+void history_print(size_t n, FILE *fp)
+{
+    unsigned long long pos, num;
+    size_t k;
+
+    if (!history_on)
+	return;
+    flock(hfd, LOCK_SH);
+    pos = hdr->head;
+    num = hdr->next;
+    for (k = 0; pos > hdr->tail && (n == 0 || k < n); ) {
+	if (!ispad(pos = prevrec(pos))) {
+	    num--;
+	    k++;
+	}
+    }
+    for (; pos < hdr->head; pos = nextrec(pos))
+	if (!ispad(pos))
+	    fprintf(fp, "%5llu  %.*s\n", num++, (int)textlen(pos), text(pos));
+    flock(hfd, LOCK_UN);
+}
+
+void history_search(const char *sub, int how, FILE *fp)
+{
+    unsigned long long pos, num;
+    size_t len = strlen(sub), i;
+
+    if (!history_on)
+	return;
+    flock(hfd, LOCK_SH);
+    if (how == 'p') {
+	if (unindexed() < hdr->head)	/* a listing wants it complete */
+	    buildindex();
+	for (i = lowerbound(sub, len); i < nidx && prefixcmp(idx[i], sub, len) == 0; i++)
+	    fprintf(fp, "%.*s\n", (int)textlen(idx[i]), text(idx[i]));
+    }
+    else {
+	for (pos = hdr->tail, num = hdr->first; pos < hdr->head; pos = nextrec(pos)) {
+	    if (ispad(pos))
+		continue;
+	    if (memmem(text(pos), textlen(pos), sub, len) != NULL)
+		fprintf(fp, "%5llu  %.*s\n", num, (int)textlen(pos), text(pos));
+	    num++;
+	}
+    }
+    flock(hfd, LOCK_UN);
+}
@@ -0,0 +1,48 @@
+//-*-c++-*-
+#ifndef _history_h_
+#define _history_h_
+
+#include <stdio.h>
+#include <stddef.h>
+
+/*
+ * Command history, kept in a file that every session maps shared and
+ * appends to under flock. The file is a fixed-size ring of records,
+ * so opening it costs the same for ten entries or ten million: it is
+ * mapped, never read or parsed, and the oldest entries are simply
+ * overwritten once it is full.
+ *
+ * Each record holds one command line and has its length at both
+ * ends, so the ring can be walked either way; a record never wraps
+ * around the end of the ring (the gap is filled by a pad record).
+ * Entries are numbered from 1 over the life of the file.
+ *
+ * Prefix search (!prefix, history -p) goes through a sorted index of
+ * the distinct lines, built on first use and topped up with a scan
+ * of whatever has been added since; substring search scans the ring.
+ */
+#define HISTSIZE (64 * 1024 * 1024)  /* default ring size, bytes (sparse) */
+
+extern int history_on;  // set by history_open
+
+/* history_open - Map the history file at path, creating it with a ring
+ *    of cap bytes if it does not exist; -1 (saying why) on failure */
+int history_open(const char *path, size_t cap);
+
+/* history_add - Append line[0..len) (a trailing newline is dropped) */
+void history_add(const char *line, size_t len);
+
+/* history_expand - If cmdline starts with a !event (!!, !N, !-N or
+ *    !prefix), return it with the event replaced by that entry, in a
+ *    buffer valid until the next call; cmdline itself if there is no
+ *    event; NULL (after saying so) if the event is not found. */
+char *history_expand(char *cmdline);
+
+/* history_print - The last n entries (all if n is 0), numbered */
+void history_print(size_t n, FILE *fp);
+
+/* history_search - Every entry containing sub (how != 'p') or, from
+ *    the index, every distinct entry starting with it (how == 'p') */
+void history_search(const char *sub, int how, FILE *fp);
+
+#endif
@@ -1,6 +1,12 @@
 #include "jobs.h"
+#include "strpool.h"
+#include "procfd.h"
+#include "trace.h"
 #include <stdio.h>
+#include <stdlib.h>
 #include <strings.h>
+#include <errno.h>
+#include <signal.h>
 #include <memory.h> // strcpy and memcpy
 
 
@@ -8,153 +14,600 @@
  * Helper routines that manipulate the job list
  **********************************************/
 
-struct job_t jobs[MAXJOBS]; /* The job list */
-static int nextjid = 1;            /* next job ID to allocate */
+struct jobtab_t jobs; /* The job list */
 
+#define JOBCHUNK 64   /* job records allocated at a time */
+
+
+/* pidslot - Home slot of pid in the PID hash */
+static inline unsigned pidslot(struct jobtab_t *jobs, pid_t pid)
+{
+    return ((unsigned)pid * 2654435761u) & (jobs->pidcap - 1);
+}
+
+/* pidinsert - Put job into the PID hash under pid (table has room) */
+static void pidinsert(struct jobtab_t *jobs, pid_t pid, struct job_t *job)
+{
+    unsigned i = pidslot(jobs, pid);
+
+    while (jobs->bypid[i].pid != 0)
+	i = (i + 1) & (jobs->pidcap - 1);
+    jobs->bypid[i].pid = pid;
+    jobs->bypid[i].pidfd = -1;
+    jobs->bypid[i].job = job;
+    jobs->npids++;
+}
+
+/* pidremove - Drop pid from the PID hash, shifting back later entries */
+static void pidremove(struct jobtab_t *jobs, pid_t pid)
+{
+    unsigned mask = jobs->pidcap - 1;
+    unsigned i = pidslot(jobs, pid), j, home;
+
+    while (jobs->bypid[i].pid != 0 && jobs->bypid[i].pid != pid)
+	i = (i + 1) & mask;
+    if (jobs->bypid[i].pid == 0)
+	return;
+
+    /* Backward-shift deletion keeps probe chains intact without
+     * tombstones. */
+    for (j = (i + 1) & mask; jobs->bypid[j].pid != 0; j = (j + 1) & mask) {
+	home = pidslot(jobs, jobs->bypid[j].pid);
+	if (((j - home) & mask) >= ((j - i) & mask)) {
+	    jobs->bypid[i] = jobs->bypid[j];
+	    i = j;
+	}
+    }
+    jobs->bypid[i].pid = 0;
+    jobs->bypid[i].pidfd = -1;
+    jobs->bypid[i].job = NULL;
+    jobs->npids--;
+}
+
+/* pidroom - Make sure the PID hash can take n more entries */
+static int pidroom(struct jobtab_t *jobs, unsigned n)
+{
+    struct pident_t *old = jobs->bypid;
+    unsigned oldcap = jobs->pidcap, cap = oldcap, i;
+
+    while (2 * (jobs->npids + n) > cap)
+	cap *= 2;
+    if (cap == oldcap)
+	return 1;
+
+    jobs->bypid = (struct pident_t *)calloc(cap, sizeof(struct pident_t));
+    if (jobs->bypid == NULL) {
+	jobs->bypid = old;
+	return 0;
+    }
+    jobs->pidcap = cap;
+    jobs->npids = 0;
+    for (i = 0; i < oldcap; i++)
+	if (old[i].pid != 0) {
+	    pidinsert(jobs, old[i].pid, old[i].job);
+	    setpidfd(jobs, old[i].pid, old[i].pidfd);
+	}
+    free(old);
+    return 1;
+}
+
+/* growjids - Make room in the JID table for jid */
+static int growjids(struct jobtab_t *jobs, int jid)
+{
+    struct job_t **byjid;
+    int cap = jobs->jidcap;
+
+    while (cap <= jid)
+	cap *= 2;
+    byjid = (struct job_t **)realloc(jobs->byjid, cap * sizeof(struct job_t *));
+    if (byjid == NULL)
+	return 0;
+    memset(byjid + jobs->jidcap, 0, (cap - jobs->jidcap) * sizeof(struct job_t *));
+    jobs->byjid = byjid;
+    jobs->jidcap = cap;
+    return 1;
+}
+
+/* growfree - Add a chunk of JOBCHUNK records to the free list */
+static int growfree(struct jobtab_t *jobs)
+{
+    struct job_t *chunk, **chunks;
+    struct jobinfo_t *info;
+    int i;
+
+    chunks = (struct job_t **)realloc(jobs->chunks,
+				      (jobs->nchunks + 1) * sizeof(struct job_t *));
+    if (chunks == NULL)
+	return 0;
+    jobs->chunks = chunks;
+    chunk = (struct job_t *)malloc(JOBCHUNK * sizeof(struct job_t));
+    info = (struct jobinfo_t *)malloc(JOBCHUNK * sizeof(struct jobinfo_t));
+    if (chunk == NULL || info == NULL) {
+	free(chunk);
+	free(info);
+	return 0;
+    }
+    jobs->chunks[jobs->nchunks++] = chunk;
+    for (i = JOBCHUNK - 1; i >= 0; i--) {
+	chunk[i].info = &info[i];
+	clearjob(&chunk[i]);
+	info[i].nextfree = jobs->freelist;
+	jobs->freelist = &chunk[i];
+    }
+    return 1;
+}
 
 /* clearjob - Clear the entries in a job struct */
 void clearjob(struct job_t *job) {
     job->pid = 0;
     job->jid = 0;
     job->state = UNDEF;
-    job->cmdline[0] = '\0';
+    job->nlive = 0;
+    job->cmdline = "";
+    job->info->nprocs = 0;
+    job->info->termsig = 0;
+    job->info->status = 0;
+    job->info->pids = NULL;
+    job->info->out = NULL;
+    job->info->nextq = NULL;
+    job->info->deadline.pprev = NULL;
+    job->info->deadsig = 0;
+    job->info->dagnode = 0;
+    job->info->cpu = 0;
+    job->info->place.flags = 0;
+    memset(&job->info->stats, 0, sizeof(job->info->stats));
 }
 
 /* initjobs - Initialize the job list */
-void initjobs(struct job_t *jobs) {
-    int i;
-
-    for (i = 0; i < MAXJOBS; i++)
-	clearjob(&jobs[i]);
+void initjobs(struct jobtab_t *jobs) {
+    memset(jobs, 0, sizeof(*jobs));
+    jobs->pidcap = 2 * MAXJOBS;
+    jobs->bypid = (struct pident_t *)calloc(jobs->pidcap, sizeof(struct pident_t));
+    jobs->jidcap = MAXJOBS + 1;
+    jobs->lowjid = 1;
+    jobs->byjid = (struct job_t **)calloc(jobs->jidcap, sizeof(struct job_t *));
+    if (jobs->bypid == NULL || jobs->byjid == NULL || !growfree(jobs)) {
+	printf("initjobs: out of memory\n");
+	exit(1);
+    }
 }
 
 /* maxjid - Returns largest allocated job ID */
-int maxjid(struct job_t *jobs) 
+int maxjid(struct jobtab_t *jobs)
 {
-    int i, max=0;
+    return jobs->maxjid;
+}
+
+/*
+ * newjob - Reserve a job record and a JID for cmdline, in state UNDEF
+ *    and without processes. Returns NULL if out of memory.
+ */
+struct job_t *newjob(struct jobtab_t *jobs, const char *cmdline)
+{
+    struct job_t *job;
+    const char *text;
+    int jid;
+
+    /* The lowest JID not in use, so a shell that keeps some jobs
+     * running while others come and go keeps its JIDs (and byjid)
+     * as small as the most jobs it has had at once */
+    for (jid = jobs->lowjid; jid <= jobs->maxjid && jobs->byjid[jid] != NULL; jid++)
+	;
+    if ((jobs->freelist == NULL && !growfree(jobs)) ||
+	(jid >= jobs->jidcap && !growjids(jobs, jid)) ||
+	(text = str_intern(cmdline, strlen(cmdline))) == NULL) {
+	printf("addjob: out of memory\n");
+	return NULL;
+    }
 
-    for (i = 0; i < MAXJOBS; i++)
-	if (jobs[i].jid > max)
-	    max = jobs[i].jid;
-    return max;
+    job = jobs->freelist;
+    jobs->freelist = job->info->nextfree;
+    job->info->nextfree = NULL;
+    job->pid = 0;
+    job->jid = jid;
+    job->state = UNDEF;
+    job->nlive = 0;
+    job->cmdline = text;
+    clock_gettime(CLOCK_REALTIME, &job->info->stats.start);
+
+    jobs->byjid[jid] = job;
+    jobs->lowjid = jid + 1;
+    if (jid > jobs->maxjid)
+	jobs->maxjid = jid;
+    jobs->nstate[UNDEF]++;
+    jobs->njobs++;
+    return job;
+}
+
+/* startjob - Give a reserved or queued job its first process */
+int startjob(struct jobtab_t *jobs, struct job_t *job, pid_t pid, int state)
+{
+    if (pid < 1)
+	return 0;
+    if (!pidroom(jobs, 1)) {
+	printf("addjob: out of memory\n");
+	return 0;
+    }
+    if (job->state == QU)
+	unqueuejob(jobs, job);
+    job->pid = pid;
+    job->nlive = 1;
+    job->info->nprocs = 1;
+    clock_gettime(CLOCK_REALTIME, &job->info->stats.start);
+    pidinsert(jobs, pid, job);
+    setjobstate(jobs, job, state);
+
+    if(verbose){
+	printf("Added job [%d] %d %s\n", job->jid, job->pid, job->cmdline);
+    }
+    return 1;
 }
 
 /* addjob - Add a job to the job list */
-int addjob(struct job_t *jobs, pid_t pid, int state, char *cmdline) 
+int addjob(struct jobtab_t *jobs, pid_t pid, int state, const char *cmdline)
 {
-    int i;
-    
+    struct job_t *job;
+
     if (pid < 1)
 	return 0;
+    if ((job = newjob(jobs, cmdline)) == NULL)
+	return 0;
+    if (!startjob(jobs, job, pid, state)) {
+	dropjob(jobs, job);
+	return 0;
+    }
+    return 1;
+}
+
+/* queuejob - Put a reserved job at the end of the QU queue */
+void queuejob(struct jobtab_t *jobs, struct job_t *job)
+{
+    setjobstate(jobs, job, QU);
+    job->info->nextq = NULL;
+    if (jobs->qtail != NULL)
+	jobs->qtail->info->nextq = job;
+    else
+	jobs->qhead = job;
+    jobs->qtail = job;
+}
 
-    for (i = 0; i < MAXJOBS; i++) {
-	if (jobs[i].pid == 0) {
-	    jobs[i].pid = pid;
-	    jobs[i].state = state;
-	    jobs[i].jid = nextjid++;
-	    if (nextjid > MAXJOBS)
-		nextjid = 1;
-	    strcpy(jobs[i].cmdline, cmdline);
-  	    if(verbose){
-	        printf("Added job [%d] %d %s\n", jobs[i].jid, jobs[i].pid, jobs[i].cmdline);
-            }
-            return 1;
+/* unqueuejob - Take a job off the QU queue (it stays QU until started
+ *    or dropped); O(1) for the head, which is the usual case */
+void unqueuejob(struct jobtab_t *jobs, struct job_t *job)
+{
+    struct job_t **pp, *prev = NULL;
+
+    for (pp = &jobs->qhead; *pp != NULL; pp = &(*pp)->info->nextq) {
+	if (*pp == job) {
+	    *pp = job->info->nextq;
+	    if (jobs->qtail == job)
+		jobs->qtail = prev;
+	    job->info->nextq = NULL;
+	    return;
 	}
+	prev = *pp;
     }
-    printf("Tried to create too many jobs\n");
-    return 0;
 }
 
-/* deletejob - Delete a job whose PID=pid from the job list */
-int deletejob(struct job_t *jobs, pid_t pid) 
+/* addjobpid - Add process pid to job, e.g. a later pipeline stage */
+int addjobpid(struct jobtab_t *jobs, struct job_t *job, pid_t pid)
 {
-    int i;
+    struct jobinfo_t *info = job->info;
+    pid_t *pids;
 
     if (pid < 1)
 	return 0;
+    if (!pidroom(jobs, 1) ||
+	(pids = (pid_t *)realloc(info->pids, info->nprocs * sizeof(pid_t))) == NULL) {
+	printf("addjobpid: out of memory\n");
+	return 0;
+    }
+    pids[info->nprocs - 1] = pid;
+    info->pids = pids;
+    info->nprocs++;
+    job->nlive++;
+    pidinsert(jobs, pid, job);
+    return 1;
+}
 
-    for (i = 0; i < MAXJOBS; i++) {
-	if (jobs[i].pid == pid) {
-	    clearjob(&jobs[i]);
-	    nextjid = maxjid(jobs)+1;
-	    return 1;
-	}
+/* addtv - a += b for timevals */
+static void addtv(struct timeval *a, const struct timeval *b)
+{
+    a->tv_sec += b->tv_sec;
+    a->tv_usec += b->tv_usec;
+    if (a->tv_usec >= 1000000) {
+	a->tv_sec++;
+	a->tv_usec -= 1000000;
     }
-    return 0;
 }
 
-/* fgpid - Return PID of current foreground job, 0 if no such job */
-pid_t fgpid(struct job_t *jobs) {
-    int i;
+/* addrusage - Add ru to sum: times and counts add up, maxrss is the max */
+void addrusage(struct rusage *sum, const struct rusage *ru)
+{
+    addtv(&sum->ru_utime, &ru->ru_utime);
+    addtv(&sum->ru_stime, &ru->ru_stime);
+    if (ru->ru_maxrss > sum->ru_maxrss)
+	sum->ru_maxrss = ru->ru_maxrss;
+    sum->ru_minflt += ru->ru_minflt;
+    sum->ru_majflt += ru->ru_majflt;
+    sum->ru_nvcsw += ru->ru_nvcsw;
+    sum->ru_nivcsw += ru->ru_nivcsw;
+}
 
-    for (i = 0; i < MAXJOBS; i++)
-	if (jobs[i].state == FG)
-	    return jobs[i].pid;
-    return 0;
+/*
+ * reapjobpid - Note that member pid of job has been reaped, adding its
+ *    resource use ru (may be NULL) to the job's. Returns how many
+ *    members are still alive; the job's own PID stays findable until
+ *    the caller deletes the job.
+ */
+int reapjobpid(struct jobtab_t *jobs, struct job_t *job, pid_t pid,
+	       const struct rusage *ru)
+{
+    if (ru != NULL)
+	addrusage(&job->info->stats.ru, ru);
+    if (pid != job->pid)
+	pidremove(jobs, pid);
+    if (--job->nlive == 0)
+	clock_gettime(CLOCK_REALTIME, &job->info->stats.end);
+    return job->nlive;
 }
 
-/* getjobpid  - Find a job (by PID) on the job list */
-struct job_t *getjobpid(struct job_t *jobs, pid_t pid) {
+/* deletejob - Delete a job whose PID=pid from the job list */
+int deletejob(struct jobtab_t *jobs, pid_t pid)
+{
+    struct job_t *job;
+
+    if ((job = getjobpid(jobs, pid)) == NULL)
+	return 0;
+    dropjob(jobs, job);
+    return 1;
+}
+
+/* dropjob - Delete a job given its record, started or not, telling
+ *    jobs->dropped first */
+void dropjob(struct jobtab_t *jobs, struct job_t *job)
+{
     int i;
 
+    if (jobs->dropped != NULL)
+	jobs->dropped(job);
+    if (job->state == QU)
+	unqueuejob(jobs, job);
+    tw_del(&job->info->deadline);
+    if (job->pid != 0)
+	pidremove(jobs, job->pid);
+    for (i = 0; i < job->info->nprocs - 1; i++)
+	pidremove(jobs, job->info->pids[i]);
+    free(job->info->pids);
+    str_release(job->cmdline);
+    jobs->byjid[job->jid] = NULL;
+    /* Walk maxjid down past the gap; each slot is passed over once
+     * per allocation, so this is O(1) amortized. */
+    while (jobs->maxjid > 0 && jobs->byjid[jobs->maxjid] == NULL)
+	jobs->maxjid--;
+    if (job->jid < jobs->lowjid)
+	jobs->lowjid = job->jid;
+    if (jobs->lowjid > jobs->maxjid + 1)
+	jobs->lowjid = jobs->maxjid + 1;
+    if (jobs->fg == job)
+	jobs->fg = NULL;
+    jobs->nstate[job->state]--;
+    jobs->njobs--;
+
+    clearjob(job);
+    job->info->nextfree = jobs->freelist;
+    jobs->freelist = job;
+}
+
+/*
+ * killjob - Send sig to every process of job. The process group is
+ *    signalled through the pidfd of a member not yet reaped, which
+ *    cannot have been recycled; kill(-pgid) is used only when no
+ *    member has a pidfd or the kernel cannot signal a group that way.
+ *    A queued or waiting job is just dropped.
+ */
+int killjob(struct jobtab_t *jobs, struct job_t *job, int sig)
+{
+    int i, fd;
+
+    if (job->state == QU || job->state == WA) {	/* nothing to signal; anything
+						 * but a SIGCONT drops it */
+	if (sig != SIGCONT)
+	    dropjob(jobs, job);
+	return 0;
+    }
+    if (job->pid == 0) {	/* never kill(-0): that is the shell */
+	errno = ESRCH;
+	return -1;
+    }
+    trace(TR_KILL, job->pid, job->jid, sig);
+
+    for (i = 0; i < job->info->nprocs; i++) {
+	fd = getpidfd(jobs, i == 0 ? job->pid : job->info->pids[i - 1]);
+	if (fd < 0)
+	    continue;
+	if (procfd_kill(fd, sig) == 0)
+	    return 0;
+	if (errno != ESRCH)
+	    break;
+    }
+    return kill(-job->pid, sig);
+}
+
+/* setjobstate - Change a job's state, tracking the FG job */
+void setjobstate(struct jobtab_t *jobs, struct job_t *job, int state)
+{
+    if (jobs->fg == job && state != FG)
+	jobs->fg = NULL;
+    jobs->nstate[job->state]--;
+    jobs->nstate[state]++;
+    job->state = state;
+    if (state == FG)
+	jobs->fg = job;
+    trace(TR_STATE, job->pid, job->jid, state);
+}
+
+/* fgpid - Return PID of current foreground job, 0 if no such job */
+pid_t fgpid(struct jobtab_t *jobs) {
+    return jobs->fg ? jobs->fg->pid : 0;
+}
+
+/* pidfind - The PID hash entry of pid, or NULL */
+static inline struct pident_t *pidfind(struct jobtab_t *jobs, pid_t pid)
+{
+    unsigned i;
+
     if (pid < 1)
 	return NULL;
-    for (i = 0; i < MAXJOBS; i++)
-	if (jobs[i].pid == pid)
-	    return &jobs[i];
+    for (i = pidslot(jobs, pid); jobs->bypid[i].pid != 0;
+	 i = (i + 1) & (jobs->pidcap - 1))
+	if (jobs->bypid[i].pid == pid)
+	    return &jobs->bypid[i];
     return NULL;
 }
 
-/* getjobjid  - Find a job (by JID) on the job list */
-struct job_t *getjobjid(struct job_t *jobs, int jid) 
+/* getjobpid  - Find a job (by PID) on the job list */
+struct job_t *getjobpid(struct jobtab_t *jobs, pid_t pid) {
+    struct pident_t *ent = pidfind(jobs, pid);
+
+    return ent ? ent->job : NULL;
+}
+
+/* getpidfd - The pidfd recorded for member pid of a job, or -1 */
+int getpidfd(struct jobtab_t *jobs, pid_t pid)
 {
-    int i;
+    struct pident_t *ent = pidfind(jobs, pid);
 
-    if (jid < 1)
+    return ent ? ent->pidfd : -1;
+}
+
+/* setpidfd - Record (or, with -1, forget) the pidfd of member pid */
+void setpidfd(struct jobtab_t *jobs, pid_t pid, int pidfd)
+{
+    struct pident_t *ent = pidfind(jobs, pid);
+
+    if (ent != NULL)
+	ent->pidfd = pidfd;
+}
+
+/* getjobjid  - Find a job (by JID) on the job list */
+struct job_t *getjobjid(struct jobtab_t *jobs, int jid)
+{
+    if (jid < 1 || jid > jobs->maxjid)
 	return NULL;
-    for (i = 0; i < MAXJOBS; i++)
-	if (jobs[i].jid == jid)
-	    return &jobs[i];
-    return NULL;
+    return jobs->byjid[jid];
 }
 
 /* pid2jid - Map process ID to job ID */
-int pid2jid(pid_t pid) 
+int pid2jid(pid_t pid)
 {
-    int i;
+    struct job_t *job = getjobpid(&jobs, pid);
 
-    if (pid < 1)
-	return 0;
-    for (i = 0; i < MAXJOBS; i++)
-	if (jobs[i].pid == pid) {
-            return jobs[i].jid;
-        }
-    return 0;
+    return job ? job->jid : 0;
 }
 
-/* listjobs - Print the job list */
-void listjobs(struct job_t *jobs) 
+/*
+ * printplace - Print the CPUs a job runs on and its nice value on one
+ *    line after prefix: its leader's, or what it is to start with
+ *    ("-" for the shell's) if it has no processes yet
+ */
+void printplace(struct job_t *job, const char *prefix)
 {
-    int i;
-    
-    for (i = 0; i < MAXJOBS; i++) {
-	if (jobs[i].pid != 0) {
-	    printf("[%d] (%d) ", jobs[i].jid, jobs[i].pid);
-	    switch (jobs[i].state) {
-		case BG: 
+    const struct place_t *pl = &job->info->place;
+    char buf[256];
+    cpu_set_t set;
+    int nice;
+
+    if (job->pid == 0) {
+	printf("%scpus %s, nice ", prefix,
+	       (pl->flags & PL_CPUS) ? cpus_format(&pl->cpus, buf, sizeof(buf)) : "-");
+	if (pl->flags & PL_NICE)
+	    printf("%d\n", pl->nice);
+	else
+	    printf("-\n");
+	return;
+    }
+    if (sched_getaffinity(job->pid, sizeof(set), &set) < 0)
+	strcpy(buf, "?");	/* the leader is gone; the rest may not be */
+    else
+	cpus_format(&set, buf, sizeof(buf));
+    errno = 0;
+    nice = getpriority(PRIO_PROCESS, job->pid);
+    if (errno != 0)
+	printf("%scpus %s, nice ?\n", prefix, buf);
+    else
+	printf("%scpus %s, nice %d\n", prefix, buf, nice);
+}
+
+/*
+ * printstats - Print a job's resource use on one line after prefix.
+ *    A job still running is timed up to now.
+ */
+void printstats(const struct jobstats_t *stats, const char *prefix)
+{
+    const struct rusage *ru = &stats->ru;
+    struct timespec end = stats->end;
+    char when[32];
+    struct tm tm;
+
+    if (end.tv_sec == 0)
+	clock_gettime(CLOCK_REALTIME, &end);
+    localtime_r(&stats->start.tv_sec, &tm);
+    strftime(when, sizeof(when), "%H:%M:%S", &tm);
+    printf("%sstart %s real %.3fs user %.3fs sys %.3fs maxrss %ldKB ctxsw %ld/%ld\n",
+	   prefix, when,
+	   (end.tv_sec - stats->start.tv_sec) +
+	   (end.tv_nsec - stats->start.tv_nsec) / 1e9,
+	   ru->ru_utime.tv_sec + ru->ru_utime.tv_usec / 1e6,
+	   ru->ru_stime.tv_sec + ru->ru_stime.tv_usec / 1e6,
+	   ru->ru_maxrss, ru->ru_nvcsw, ru->ru_nivcsw);
+}
+
+/*
+ * listjobs - Print the job list. With details, each job is followed
+ *    by its member PIDs and the resource use of the members reaped
+ *    so far.
+ */
+void listjobs(struct jobtab_t *jobs, int details)
+{
+    struct job_t *job;
+    int i, k;
+
+    for (i = 1; i <= jobs->maxjid; i++) {
+	if ((job = jobs->byjid[i]) != NULL) {
+	    if (job->state == QU || job->state == WA)
+		printf("[%d] (-) ", job->jid);
+	    else
+		printf("[%d] (%d) ", job->jid, job->pid);
+	    switch (job->state) {
+		case BG:
 		    printf("Running ");
 		    break;
-		case FG: 
+		case FG:
 		    printf("Foreground ");
 		    break;
-		case ST: 
+		case ST:
 		    printf("Stopped ");
 		    break;
+		case QU:
+		    printf("Queued ");
+		    break;
+		case WA:
+		    printf("Waiting ");
+		    break;
 	    default:
-		    printf("listjobs: Internal error: job[%d].state=%d ", 
-			   i, jobs[i].state);
+		    printf("listjobs: Internal error: job[%d].state=%d ",
+			   i, job->state);
+	    }
+	    printf("%s", job->cmdline);
+	    if (details) {
+		printf("    pids %d", job->pid);
+		for (k = 0; k < job->info->nprocs - 1; k++)
+		    printf(" %d", job->info->pids[k]);
+		printf(" (%d running)\n", job->nlive);
+		printplace(job, "    ");
+		printstats(&job->info->stats, "    ");
 	    }
-	    printf("%s", jobs[i].cmdline);
 	}
     }
 }
@@ -3,13 +3,19 @@
 #define _jobs_h_
 
 #include <sys/types.h> // needed for pid_t
+#include <sys/resource.h> // struct rusage
+#include <time.h>
 #include "globals.h"
+#include "timerwheel.h"
+#include "place.h"
 
 /* Job states */
 #define UNDEF 0 /* undefined */
 #define FG 1    /* running in foreground */
 #define BG 2    /* running in background */
 #define ST 3    /* stopped */
+#define QU 4    /* queued: waiting for a free slot (no processes yet) */
+#define WA 5    /* waiting for the jobs it runs after (no processes yet) */
 
 /* 
  * Jobs states: FG (foreground), BG (background), ST (stopped)
@@ -18,28 +24,129 @@
  *     ST -> FG  : fg command
  *     ST -> BG  : bg command
  *     BG -> FG  : fg command
+ *     QU -> BG  : a running job finishes (job limit), or bg command
+ *     QU -> FG  : fg command
+ *     WA -> BG  : the jobs it runs after succeed (after builtin)
+ *     WA -> QU  : ... while at the job limit
  * At most 1 job can be in the FG state.
  */
 
+/*
+ * Resource use of a job: wall-clock times from CLOCK_REALTIME and
+ * the rusage of its members as reported by wait4, summed (max for
+ * ru_maxrss) over the members reaped so far.
+ */
+struct jobstats_t {
+    struct timespec start;  /* when the job was added */
+    struct timespec end;    /* when its last member was reaped */
+    struct rusage ru;
+};
+
+/*
+ * A job is one process or a pipeline of them, all in the process
+ * group of the first one, whose PID identifies the job. It is done
+ * once every member has been reaped.
+ *
+ * struct job_t holds only what lookups and state changes touch, 32
+ * bytes, so scanning or probing the table stays within a few cache
+ * lines. The command line is interned in the string pool (strpool.h)
+ * and everything else sits in a separate struct jobinfo_t.
+ */
+struct jobinfo_t;
+struct outring_t;
+
 struct job_t {              /* The job struct */
-    pid_t pid;              /* job PID */
+    pid_t pid;              /* job PID, also its process group ID */
     int jid;                /* job ID [1, 2, ...] */
     int state;              /* UNDEF, BG, FG, or ST */
-    char cmdline[MAXLINE];  /* command line */
+    int nlive;              /* members not yet reaped */
+    const char *cmdline;    /* command line, "" if unused */
+    struct jobinfo_t *info; /* the rest; fixed for the record's life */
+};
+
+struct jobinfo_t {          /* The cold part of a job */
+    int nprocs;             /* processes in the job */
+    int termsig;            /* signal that killed a member, or 0 */
+    int status;             /* wait status of the last stage */
+    pid_t *pids;            /* members other than pid, NULL if none */
+    struct outring_t *out;  /* captured output (tsh -o), or NULL */
+    struct jobstats_t stats;
+    struct job_t *nextfree; /* free-list link while unused */
+    struct job_t *nextq;    /* queue link while QU */
+    struct wtimer_t deadline; /* when the job is to be killed, if armed */
+    int deadsig;            /* ... with this signal (SIGTERM, then SIGKILL) */
+    int dagnode;            /* its node in the after graph + 1, or 0 */
+    int cpu;                /* CPU tsh -a pinned it to + 1, or 0 */
+    struct place_t place;   /* what affinity and nice set before it started */
+};
+
+struct pident_t {           /* PID hash entry */
+    pid_t pid;              /* 0 if the slot is empty */
+    int pidfd;              /* pidfd (procfd.h) of the process, or -1 */
+    struct job_t *job;
+};
+
+/*
+ * The job list. Job records (and their jobinfo_t, in parallel arrays)
+ * live in fixed-size chunks that are never moved, so a struct job_t * stays valid until the job is deleted.
+ * Jobs are found by JID through a directly indexed table and by the
+ * PID of any member through an open-addressed hash; both grow on
+ * demand in addjob. The hash also holds each member's pidfd while
+ * the shell has one open, until the member is reaped.
+ * State changes must go through setjobstate so the cached
+ * foreground job and the per-state counts stay correct.
+ *
+ * A job can exist before its processes do: newjob reserves a record
+ * and a JID, and startjob gives it its leader's PID once launched.
+ * Until then it has PID 0 and is found only by JID, either on its
+ * way to being started or waiting in the QU queue.
+ */
+struct jobtab_t {
+    struct pident_t *bypid; /* PID hash, linear probing */
+    unsigned pidcap;        /* size of bypid, a power of two */
+    unsigned npids;         /* entries in bypid */
+    struct job_t **byjid;   /* byjid[jid], NULL if jid unused */
+    int jidcap;             /* size of byjid */
+    int maxjid;             /* largest JID in use, 0 if none */
+    int lowjid;             /* every JID below it is in use */
+    int njobs;              /* number of jobs in the list */
+    struct job_t *fg;       /* the FG job, or NULL */
+    int nstate[6];          /* number of jobs in each state */
+    struct job_t *qhead;    /* QU jobs, oldest first */
+    struct job_t *qtail;
+    struct job_t *freelist; /* unused job records */
+    struct job_t **chunks;  /* every chunk of records allocated */
+    int nchunks;
+    void (*dropped)(struct job_t *job); /* told of each job as it goes */
 };
-extern struct job_t jobs[MAXJOBS]; /* The job list */
+extern struct jobtab_t jobs; /* The job list */
 
 
 void clearjob(struct job_t *job);
-void initjobs(struct job_t *jobs);
-int maxjid(struct job_t *jobs); 
-int addjob(struct job_t *jobs, pid_t pid, int state, char *cmdline);
-int deletejob(struct job_t *jobs, pid_t pid); 
-pid_t fgpid(struct job_t *jobs);
-struct job_t *getjobpid(struct job_t *jobs, pid_t pid);
-struct job_t *getjobjid(struct job_t *jobs, int jid); 
+void initjobs(struct jobtab_t *jobs);
+int maxjid(struct jobtab_t *jobs); 
+int addjob(struct jobtab_t *jobs, pid_t pid, int state, const char *cmdline);
+struct job_t *newjob(struct jobtab_t *jobs, const char *cmdline);
+int startjob(struct jobtab_t *jobs, struct job_t *job, pid_t pid, int state);
+void queuejob(struct jobtab_t *jobs, struct job_t *job);
+void unqueuejob(struct jobtab_t *jobs, struct job_t *job);
+void dropjob(struct jobtab_t *jobs, struct job_t *job);
+int addjobpid(struct jobtab_t *jobs, struct job_t *job, pid_t pid);
+int reapjobpid(struct jobtab_t *jobs, struct job_t *job, pid_t pid,
+	       const struct rusage *ru);
+int deletejob(struct jobtab_t *jobs, pid_t pid); 
+int getpidfd(struct jobtab_t *jobs, pid_t pid);
+void setpidfd(struct jobtab_t *jobs, pid_t pid, int pidfd);
+int killjob(struct jobtab_t *jobs, struct job_t *job, int sig);
+void setjobstate(struct jobtab_t *jobs, struct job_t *job, int state);
+pid_t fgpid(struct jobtab_t *jobs);
+struct job_t *getjobpid(struct jobtab_t *jobs, pid_t pid);
+struct job_t *getjobjid(struct jobtab_t *jobs, int jid); 
 int pid2jid(pid_t pid); 
-void listjobs(struct job_t *jobs);
+void listjobs(struct jobtab_t *jobs, int details);
+void printplace(struct job_t *job, const char *prefix);
+void printstats(const struct jobstats_t *stats, const char *prefix);
+void addrusage(struct rusage *sum, const struct rusage *ru);
 
 
 #endif
@@ -0,0 +1,457 @@
+#include "launch.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <alloca.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+/***********************************
+ * Routines that start child processes
+ ***********************************/
+
+int launch_mode = LAUNCH_SPAWN;
+
+/* Signals the shell installs handlers for; children get the defaults */
+static const int caught[] = { SIGINT, SIGTSTP, SIGCHLD, SIGQUIT };
+
+/*
+ * launch - Start path with the configured method. Returns the
+ *    child's PID, or -1 with errno set if it could not be started.
+ */
+pid_t launch(const char *path, char **argv, pid_t pgid,
+	     const struct childio_t *io, const sigset_t *childmask)
+{
+    if (launch_mode == LAUNCH_FORK)
+	return launch_fork(path, argv, pgid, io, childmask);
+    if (launch_mode == LAUNCH_ZYGOTE)
+	return launch_zygote(path, argv, pgid, io, childmask);
+    return launch_spawn(path, argv, pgid, io, childmask);
+}
+
+/*
+ * launch_spawn - Start path with posix_spawn. The process group,
+ *    descriptors and signal state are set up by the library between
+ *    clone and exec, exactly where the fork path does it by hand.
+ *    posix_spawn has no attribute for CPUs or the nice value, and
+ *    setting them on the new PID would be after its exec, so a child
+ *    that is to be placed is started by launch_fork instead.
+ */
+pid_t launch_spawn(const char *path, char **argv, pid_t pgid,
+		   const struct childio_t *io, const sigset_t *childmask)
+{
+    posix_spawn_file_actions_t fa, *fap = NULL;
+    posix_spawnattr_t attr;
+    const struct redir_t *r;
+    sigset_t dfl;
+    pid_t pid;
+    unsigned i;
+    int err;
+
+    if (io != NULL && io->place != NULL)
+	return launch_fork(path, argv, pgid, io, childmask);
+    sigemptyset(&dfl);
+    for (i = 0; i < sizeof(caught) / sizeof(caught[0]); i++)
+	sigaddset(&dfl, caught[i]);
+
+    posix_spawnattr_init(&attr);
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP |
+			     POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+    posix_spawnattr_setpgroup(&attr, pgid);
+    posix_spawnattr_setsigmask(&attr, childmask);
+    posix_spawnattr_setsigdefault(&attr, &dfl);
+
+    if (io != NULL) {
+	posix_spawn_file_actions_init(&fa);
+	for (i = 0; i < 3; i++)
+	    if (io->fds[i] >= 0 && io->fds[i] != (int)i)
+		posix_spawn_file_actions_adddup2(&fa, io->fds[i], i);
+	for (r = io->redirs; r < io->redirs + io->nredirs; r++) {
+	    if (r->path != NULL)
+		posix_spawn_file_actions_addopen(&fa, r->fd, r->path, r->flags, 0666);
+	    else
+		posix_spawn_file_actions_adddup2(&fa, r->dupfd, r->fd);
+	}
+	fap = &fa;
+    }
+
+    err = posix_spawn(&pid, path, fap, &attr, argv, environ);
+    if (fap != NULL)
+	posix_spawn_file_actions_destroy(fap);
+    posix_spawnattr_destroy(&attr);
+    if (err != 0) {
+	errno = err;
+	return -1;
+    }
+    return pid;
+}
+
+/*
+ * forkchild - fork and set up the child's process group, descriptors
+ *    and signals. Returns like fork. The parent also sets the group,
+ *    so later pipeline stages can join it whichever side runs first.
+ *    A child that cannot be placed or open a redirection says so and
+ *    exits 1.
+ */
+static void childsetup(pid_t pgid, const struct childio_t *io,
+		       const sigset_t *childmask);
+
+static pid_t forkchild(pid_t pgid, const struct childio_t *io,
+		       const sigset_t *childmask)
+{
+    pid_t pid;
+
+    if ((pid = fork()) != 0) {
+	if (pid > 0)
+	    setpgid(pid, pgid);
+	return pid;
+    }
+    childsetup(pgid, io, childmask);
+    return 0;
+}
+
+/* childsetup - The child's half of forkchild (and of the zygote's
+ *    clone): signals, process group, CPUs and nice value, descriptors */
+static void childsetup(pid_t pgid, const struct childio_t *io,
+		       const sigset_t *childmask)
+{
+    const struct redir_t *r;
+    unsigned i;
+    int fd;
+
+    for (i = 0; i < sizeof(caught) / sizeof(caught[0]); i++)
+	signal(caught[i], SIG_DFL);
+    sigprocmask(SIG_SETMASK, childmask, NULL);
+    setpgid(0, pgid);
+    if (io == NULL)
+	return;
+    if (io->place != NULL && place_apply(0, io->place) < 0) {
+	fprintf(stderr, "(%d): cannot set CPUs or nice value: %s\n",
+		(int)getpid(), strerror(errno));
+	_exit(1);
+    }
+    for (i = 0; i < 3; i++)
+	if (io->fds[i] >= 0 && io->fds[i] != (int)i)
+	    dup2(io->fds[i], i);
+    for (r = io->redirs; r < io->redirs + io->nredirs; r++) {
+	if (r->path == NULL) {
+	    dup2(r->dupfd, r->fd);
+	    continue;
+	}
+	if ((fd = open(r->path, r->flags | O_CLOEXEC, 0666)) < 0) {
+	    fprintf(stderr, "%s: %s\n", r->path, strerror(errno));
+	    _exit(1);
+	}
+	if (fd != r->fd) {
+	    dup2(fd, r->fd);
+	    close(fd);
+	}
+	else
+	    fcntl(fd, F_SETFD, 0);  /* it is the one we want to keep */
+    }
+}
+
+/*
+ * launch_fork - Start path with fork and execv. If execv fails
+ *    the child prints the error and exits.
+ */
+pid_t launch_fork(const char *path, char **argv, pid_t pgid,
+		  const struct childio_t *io, const sigset_t *childmask)
+{
+    pid_t pid;
+
+    if ((pid = forkchild(pgid, io, childmask)) != 0)
+	return pid;
+    execv(path, argv);
+    printf("%s: Command not found\n", argv[0]);
+    exit(0);
+}
+
+/* launch_func - Run fn(argv) in a forked child, see launch.h */
+pid_t launch_func(int (*fn)(char **), char **argv, pid_t pgid,
+		  const struct childio_t *io, const sigset_t *childmask)
+{
+    pid_t pid;
+    int rc;
+
+    fflush(stdout);  /* or the child would print it a second time */
+    if ((pid = forkchild(pgid, io, childmask)) != 0)
+	return pid;
+    /* No exec will close the shell's other descriptors for us, and
+     * a stray pipe write end would keep the next stage from seeing EOF */
+    close_range(3, ~0U, 0);
+    rc = fn(argv);
+    fflush(stdout);
+    _exit(rc);
+}
+
+/*
+ * The zygote. A launch request is one SOCK_SEQPACKET message: a
+ * zreq_t, nredirs zredir_t, then NUL-terminated strings (path, the
+ * arguments, the environment, the redirections' paths), with the
+ * child's descriptors 0, 1 and 2 attached as SCM_RIGHTS. The reply
+ * is a zrep_t.
+ */
+#define ZMSGMAX (128 * 1024)   /* larger requests go through posix_spawn */
+
+struct zreq_t {
+    pid_t pgid;
+    int nargs, nenv, nredirs;
+    sigset_t mask;
+    struct place_t place;   /* flags 0: none */
+};
+
+struct zredir_t {
+    int fd, flags, dupfd, haspath;
+};
+
+struct zrep_t {
+    pid_t pid;      /* the child, or -1 */
+    int err;        /* errno of a failed clone or exec, else 0 */
+};
+
+static int zsock = -1;         /* the shell's end of the socketpair */
+static pid_t zpid;
+
+/* What a zygote's child needs; it shares the zygote's memory */
+struct zchild_t {
+    pid_t pgid;
+    const struct childio_t *io;
+    const sigset_t *mask;
+    const char *path;
+    char **argv, **envp;
+    int err;        /* set by the child if the exec fails */
+};
+
+/* zchild - The child's side: set up and exec, on its own stack */
+static int zchild(void *arg)
+{
+    struct zchild_t *c = (struct zchild_t *)arg;
+
+    childsetup(c->pgid, c->io, c->mask);
+    execve(c->path, c->argv, c->envp);
+    c->err = errno;
+    _exit(127);
+}
+
+/*
+ * zspawn - In the zygote: start one request's child. It is created
+ *    as posix_spawn does, with clone(CLONE_VM|CLONE_VFORK) on a
+ *    separate stack, so no page tables are copied and the zygote
+ *    resumes only once the child has exec'd or died; CLONE_PARENT
+ *    makes it the shell's child, to wait for as any other.
+ */
+static void zspawn(char *buf, int *fds, struct zrep_t *rep)
+{
+    static char stack[64 * 1024] __attribute__((aligned(16)));
+    struct zreq_t *rq = (struct zreq_t *)buf;
+    struct zredir_t *zr = (struct zredir_t *)(rq + 1);
+    struct redir_t redirs[64];
+    struct childio_t io;
+    struct zchild_t c;
+    char *p = (char *)(zr + rq->nredirs);
+    int i;
+
+    rep->pid = -1;
+    rep->err = E2BIG;
+    if (rq->nredirs > 64)
+	return;
+    c.argv = (char **)alloca((rq->nargs + rq->nenv + 2) * sizeof(char *));
+    c.envp = c.argv + rq->nargs + 1;
+    c.path = p;
+    p += strlen(p) + 1;
+    for (i = 0; i < rq->nargs; i++, p += strlen(p) + 1)
+	c.argv[i] = p;
+    c.argv[i] = NULL;
+    for (i = 0; i < rq->nenv; i++, p += strlen(p) + 1)
+	c.envp[i] = p;
+    c.envp[i] = NULL;
+    for (i = 0; i < rq->nredirs; i++) {
+	redirs[i].fd = zr[i].fd;
+	redirs[i].flags = zr[i].flags;
+	redirs[i].dupfd = zr[i].dupfd;
+	redirs[i].path = NULL;
+	if (zr[i].haspath) {
+	    redirs[i].path = p;
+	    p += strlen(p) + 1;
+	}
+    }
+    io.fds[0] = fds[0];
+    io.fds[1] = fds[1];
+    io.fds[2] = fds[2];
+    io.redirs = redirs;
+    io.nredirs = rq->nredirs;
+    io.place = rq->place.flags != 0 ? &rq->place : NULL;
+    c.pgid = rq->pgid;
+    c.io = &io;
+    c.mask = &rq->mask;
+    c.err = 0;
+
+    rep->pid = clone(zchild, stack + sizeof(stack),
+		     CLONE_VM | CLONE_VFORK | CLONE_PARENT | SIGCHLD, &c);
+    rep->err = rep->pid < 0 ? errno : c.err;
+}
+
+/* zygote_main - Serve launch requests until the shell goes away */
+static void zygote_main(int sock)
+{
+    static char buf[ZMSGMAX];
+    char cbuf[CMSG_SPACE(3 * sizeof(int))];
+    struct msghdr msg;
+    struct cmsghdr *cm;
+    struct iovec iov;
+    struct zrep_t rep;
+    int fds[3], i;
+    ssize_t n;
+
+    for (;;) {
+	memset(&msg, 0, sizeof(msg));
+	iov.iov_base = buf;
+	iov.iov_len = sizeof(buf);
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	msg.msg_control = cbuf;
+	msg.msg_controllen = sizeof(cbuf);
+	if ((n = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC)) <= 0) {
+	    if (n < 0 && errno == EINTR)
+		continue;
+	    _exit(0);
+	}
+	fds[0] = fds[1] = fds[2] = -1;
+	if ((cm = CMSG_FIRSTHDR(&msg)) != NULL && cm->cmsg_type == SCM_RIGHTS)
+	    memcpy(fds, CMSG_DATA(cm), 3 * sizeof(int));
+	if ((size_t)n < sizeof(struct zreq_t) || fds[2] < 0) {
+	    rep.pid = -1;
+	    rep.err = EINVAL;
+	}
+	else
+	    zspawn(buf, fds, &rep);
+	for (i = 0; i < 3; i++)
+	    if (fds[i] >= 0)
+		close(fds[i]);
+	send(sock, &rep, sizeof(rep), MSG_NOSIGNAL);
+    }
+}
+
+/*
+ * zygote_start - Fork the zygote. Its signal mask is the caller's,
+ *    which for the shell blocks everything it catches, and it leaves
+ *    the shell's process group so ctrl-c and ctrl-z never reach it.
+ */
+int zygote_start(void)
+{
+    int sv[2];
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, sv) < 0)
+	return -1;
+    if ((zpid = fork()) < 0) {
+	close(sv[0]);
+	close(sv[1]);
+	return -1;
+    }
+    if (zpid == 0) {
+	close(sv[0]);
+	setpgid(0, 0);
+	zygote_main(sv[1]);
+    }
+    close(sv[1]);
+    zsock = sv[0];
+    return 0;
+}
+
+/* zpack - Append string s at *p if it fits before end; NULL if not */
+static char *zpack(char *p, const char *end, const char *s)
+{
+    size_t n = strlen(s) + 1;
+
+    if (p == NULL || p + n > end)
+	return NULL;
+    memcpy(p, s, n);
+    return p + n;
+}
+
+/*
+ * launch_zygote - Have the zygote start path. Falls back to
+ *    posix_spawn for a request too large for one message, and for
+ *    good if the zygote has died.
+ */
+pid_t launch_zygote(const char *path, char **argv, pid_t pgid,
+		    const struct childio_t *io, const sigset_t *childmask)
+{
+    static char buf[ZMSGMAX];
+    char cbuf[CMSG_SPACE(3 * sizeof(int))];
+    struct zreq_t *rq = (struct zreq_t *)buf;
+    struct zredir_t *zr = (struct zredir_t *)(rq + 1);
+    const char *end = buf + sizeof(buf);
+    struct msghdr msg;
+    struct cmsghdr *cm;
+    struct iovec iov;
+    struct zrep_t rep;
+    int fds[3], i, nredirs = io != NULL ? io->nredirs : 0;
+    char *p;
+    ssize_t n;
+
+    if (zsock < 0 || nredirs > 64)
+	return launch_spawn(path, argv, pgid, io, childmask);
+
+    rq->pgid = pgid;
+    rq->mask = *childmask;
+    rq->nredirs = nredirs;
+    rq->place.flags = 0;
+    if (io != NULL && io->place != NULL)
+	rq->place = *io->place;
+    p = (char *)(zr + nredirs);
+    p = zpack(p, end, path);
+    for (rq->nargs = 0; argv[rq->nargs] != NULL; rq->nargs++)
+	p = zpack(p, end, argv[rq->nargs]);
+    for (rq->nenv = 0; environ[rq->nenv] != NULL; rq->nenv++)
+	p = zpack(p, end, environ[rq->nenv]);
+    for (i = 0; i < nredirs; i++) {
+	zr[i].fd = io->redirs[i].fd;
+	zr[i].flags = io->redirs[i].flags;
+	zr[i].dupfd = io->redirs[i].dupfd;
+	if ((zr[i].haspath = (io->redirs[i].path != NULL)))
+	    p = zpack(p, end, io->redirs[i].path);
+    }
+    if (p == NULL)
+	return launch_spawn(path, argv, pgid, io, childmask);
+
+    /* The child's 0, 1 and 2: the shell's own unless io says otherwise */
+    for (i = 0; i < 3; i++)
+	fds[i] = (io != NULL && io->fds[i] >= 0) ? io->fds[i] : i;
+    memset(&msg, 0, sizeof(msg));
+    iov.iov_base = buf;
+    iov.iov_len = p - buf;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = cbuf;
+    msg.msg_controllen = sizeof(cbuf);
+    cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(3 * sizeof(int));
+    memcpy(CMSG_DATA(cm), fds, 3 * sizeof(int));
+
+    if (sendmsg(zsock, &msg, MSG_NOSIGNAL) < 0 ||
+	(n = recv(zsock, &rep, sizeof(rep), 0)) != sizeof(rep)) {
+	close(zsock);		/* the zygote is gone: no more of it */
+	zsock = -1;
+	waitpid(zpid, NULL, WNOHANG);
+	launch_mode = LAUNCH_SPAWN;
+	return launch_spawn(path, argv, pgid, io, childmask);
+    }
+    if (rep.err != 0) {
+	if (rep.pid > 0)	/* exec failed; ours to reap */
+	    waitpid(rep.pid, NULL, 0);
+	errno = rep.err;
+	return -1;
+    }
+    return rep.pid;
+}
@@ -0,0 +1,88 @@
+//-*-c++-*-
+#ifndef _launch_h_
+#define _launch_h_
+
+#include <signal.h>
+#include <sys/types.h>
+#include "place.h"
+
+/*
+ * A redirection: descriptor fd (0, 1 or 2) becomes the file path
+ * opened with flags (mode 0666), or, if path is NULL, a copy of
+ * descriptor dupfd.
+ */
+struct redir_t {
+    int fd;
+    int flags;
+    const char *path;
+    int dupfd;
+};
+
+/*
+ * A child's standard descriptors: each fds[i] that is not -1 is
+ * dup'ed onto i (-1: inherit the shell's), then the redirections are
+ * applied in order, so "> out 2>&1" and "2>&1 > out" differ as in sh.
+ * The files are opened by the child, never by the shell. place, if
+ * not NULL, says which CPUs the child runs on and at what nice value.
+ */
+struct childio_t {
+    int fds[3];
+    const struct redir_t *redirs;
+    int nredirs;
+    const struct place_t *place;
+};
+
+/*
+ * Ways of starting an external command: execute the file path with
+ * arguments argv. Both put the child in process group pgid (0: a new
+ * group led by the child), set up its stdin, stdout and stderr as io
+ * says (io may be NULL to inherit the shell's), and start it with
+ * signal mask childmask and default dispositions for the signals the
+ * shell catches. Descriptors the shell opens for a child should be
+ * O_CLOEXEC so that only the three standard ones survive the exec.
+ *
+ *   LAUNCH_SPAWN  posix_spawn; glibc creates the child with
+ *                 clone(CLONE_VM|CLONE_VFORK), so no page tables
+ *                 are copied and exec errors (and redirection
+ *                 errors, indistinguishably) come back to the caller.
+ *                 A child with a place goes to LAUNCH_FORK, as
+ *                 posix_spawn cannot set CPUs or nice values.
+ *   LAUNCH_FORK   the classic fork/setpgid/execv sequence; an exec,
+ *                 placement or redirection error is reported by the
+ *                 child itself, which then exits.
+ *   LAUNCH_ZYGOTE a helper process forked at startup (zygote_start),
+ *                 while the shell is still small, starts the child
+ *                 with clone(CLONE_PARENT), so the child is the
+ *                 shell's to wait for but its creation never copies
+ *                 the shell's grown address space. Requests and the
+ *                 child's descriptors go over a socketpair. Exec
+ *                 errors come back like posix_spawn's; a redirection
+ *                 error is reported by the child as with LAUNCH_FORK.
+ */
+#define LAUNCH_SPAWN  0
+#define LAUNCH_FORK   1
+#define LAUNCH_ZYGOTE 2
+
+extern int launch_mode;  // LAUNCH_SPAWN unless changed
+
+pid_t launch(const char *path, char **argv, pid_t pgid,
+	     const struct childio_t *io, const sigset_t *childmask);
+pid_t launch_spawn(const char *path, char **argv, pid_t pgid,
+		   const struct childio_t *io, const sigset_t *childmask);
+pid_t launch_fork(const char *path, char **argv, pid_t pgid,
+		  const struct childio_t *io, const sigset_t *childmask);
+pid_t launch_zygote(const char *path, char **argv, pid_t pgid,
+		    const struct childio_t *io, const sigset_t *childmask);
+
+/* zygote_start - Fork the zygote for LAUNCH_ZYGOTE; -1 if it can't */
+int zygote_start(void);
+
+/*
+ * launch_func - Like launch_fork, but the child runs fn(argv) and
+ *    exits with its return value instead of exec'ing. Used for
+ *    pipeline stages the shell implements itself.
+ */
+pid_t launch_func(int (*fn)(char **), char **argv, pid_t pgid,
+		  const struct childio_t *io, const sigset_t *childmask);
+
+#endif
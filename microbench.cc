@@ -0,0 +1,404 @@
+/*
+ * microbench.c - In-process microbenchmarks for the shell's hot paths
+ *
+ * usage: microbench [-n <iters>] [-b <children>]
+ *
+ * Links the shell itself (tsh.c built with TSH_NOMAIN) and times its
+ * routines directly, with no pipes or prompts in the way:
+ *
+ * parseline     parseline() on short, typical and long command lines.
+ * tokenize      tokenize_line(), the shell's tokenizer, on the same
+ *               lines and on 4 KB and 64 KB lines of plain and quoted
+ *               words; also reports MB/s.
+ * jobs          addjob+deletejob churn, getjobpid and getjobjid on a
+ *               job list holding 16, 1000 and 10000 jobs.
+ * builtin       builtin_cmd() on "jobs" with an empty job list, and the
+ *               same line through eval() (parse + dispatch).
+ * spawn_reap    eval("/bin/true") as an external program: launch, wait
+ *               in the event loop, reap; and the same line run by the
+ *               native true (utils.h) for comparison.
+ * sigchld_burst <children> background /bin/true jobs are left to exit,
+ *               then the time for the event loop to reap them all
+ *               (one pidfd event each, see procfd.h).
+ * timers        tw_add+tw_del of a deadline with 16, 1000 and 100000
+ *               others armed, and the cost per timer of expiring that
+ *               many at once (timerwheel.h).
+ *
+ * Results are printed one per line as "<name> key=value ...", like
+ * tshbench, so they can be collected and compared across releases.
+ * Anything the shell itself prints goes to /dev/null.
+ */
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "globals.h"
+#include "jobs.h"
+#include "helper-routines.h"
+#include "evloop.h"
+#include "tokenize.h"
+#include "utils.h"
+#include "timerwheel.h"
+#include "history.h"
+
+/* From tsh.c */
+void tsh_init(void);
+void eval(char *cmdline);
+int builtin_cmd(char **argv, int inshell);
+
+static int iters = 100000;
+static int burst = 500;
+static FILE *out;
+
+/* now_ns - monotonic clock in nanoseconds */
+static long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* report - print the mean cost of one of n operations that took ns */
+static void report(const char *name, const char *extra, int n, long long ns)
+{
+    fprintf(out, "%s %sn=%d ns_per_op=%.1f ops_per_sec=%.0f\n",
+	    name, extra, n, (double)ns / n, n / (ns / 1e9));
+    fflush(out);
+}
+
+/* bench_parseline - parse short, typical and long command lines */
+static void bench_parseline(void)
+{
+    static const char *lines[] = {
+	"jobs\n",
+	"/bin/echo hello world &\n",
+	"./myspin 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20 "
+	"21 22 23 24 25 26 27 28 29 30 31 32 '33 34 35' 36 37 38 39 40\n",
+    };
+    char *argv[MAXARGS];
+    char extra[64];
+    long long t0;
+    int i, l, argc = 0;
+
+    for (l = 0; l < 3; l++) {
+	t0 = now_ns();
+	for (i = 0; i < iters; i++)
+	    argc += parseline(lines[l], argv);
+	snprintf(extra, sizeof(extra), "len=%d ", (int)strlen(lines[l]));
+	report("parseline", extra, iters, now_ns() - t0);
+    }
+    if (argc < 0)		/* keep the loop from being optimized away */
+	fprintf(out, "\n");
+}
+
+/* bench_tokenize - the tokenizer on the parseline lines and on long ones */
+static void bench_tokenize(void)
+{
+    static const char *lines[] = {
+	"jobs\n",
+	"/bin/echo hello world &\n",
+	"./myspin 1 2 3 4 5 6 7 8 9 10 11 12 13 14 15 16 17 18 19 20 "
+	"21 22 23 24 25 26 27 28 29 30 31 32 '33 34 35' 36 37 38 39 40\n",
+    };
+    static const char *words[] = {
+	"/usr/local/bin/somecommand", "--option=value", "'a quoted arg'",
+	"\"double $quoted\"", "plain", "esc\\ aped", "file.txt",
+    };
+    struct toklist_t tl;
+    char extra[64], *big;
+    size_t len, size;
+    long long t0, ns;
+    int i, l, n, ntoks = 0;
+
+    memset(&tl, 0, sizeof(tl));
+    for (l = 0; l < 3; l++) {
+	len = strlen(lines[l]);
+	t0 = now_ns();
+	for (i = 0; i < iters; i++)
+	    ntoks += tokenize_line(lines[l], len, &tl);
+	snprintf(extra, sizeof(extra), "len=%d ", (int)len);
+	report("tokenize", extra, iters, now_ns() - t0);
+    }
+
+    for (size = 4096; size <= 65536; size *= 16) {
+	big = (char *)malloc(size + 64);
+	for (len = 0, i = 0; len < size; i++)
+	    len += sprintf(big + len, "%s ", words[i % 7]);
+	big[len - 1] = '\n';
+	n = iters / (int)(size / 64) > 0 ? iters / (int)(size / 64) : 1;
+	t0 = now_ns();
+	for (i = 0; i < n; i++)
+	    ntoks += tokenize_line(big, len, &tl);
+	ns = now_ns() - t0;
+	fprintf(out, "tokenize len=%d n=%d ns_per_op=%.1f mb_per_sec=%.1f\n",
+		(int)len, n, (double)ns / n, (double)len * n / 1e6 / (ns / 1e9));
+	fflush(out);
+	free(big);
+    }
+    if (ntoks < 0)
+	fprintf(out, "\n");
+    tokfree(&tl);
+}
+
+/* bench_jobs - job list operations with <size> jobs already in the list */
+static void bench_jobs(int size)
+{
+    struct jobtab_t tab;
+    char extra[64];
+    long long t0;
+    unsigned seed = 1;
+    long hits = 0;
+    int i;
+
+    memset(&tab, 0, sizeof(tab));
+    initjobs(&tab);
+    for (i = 0; i < size; i++)
+	addjob(&tab, 100000 + i, BG, "./myspin 10 &\n");
+    snprintf(extra, sizeof(extra), "size=%d ", size);
+
+    /* a job comes and goes at the end of a list of <size> */
+    t0 = now_ns();
+    for (i = 0; i < iters; i++) {
+	addjob(&tab, 900000 + (i & 1023), BG, "./myspin 10 &\n");
+	deletejob(&tab, 900000 + (i & 1023));
+    }
+    report("jobs_add_delete", extra, iters, now_ns() - t0);
+
+    t0 = now_ns();
+    for (i = 0; i < iters; i++) {
+	seed = seed * 1103515245 + 12345;
+	hits += getjobpid(&tab, 100000 + (seed >> 8) % size) != NULL;
+    }
+    report("jobs_getjobpid", extra, iters, now_ns() - t0);
+
+    t0 = now_ns();
+    for (i = 0; i < iters; i++) {
+	seed = seed * 1103515245 + 12345;
+	hits += getjobjid(&tab, 1 + (seed >> 8) % size) != NULL;
+    }
+    report("jobs_getjobjid", extra, iters, now_ns() - t0);
+
+    if (hits != 2L * iters)
+	fprintf(out, "jobs_lookup size=%d error=missed_%ld\n",
+		size, 2L * iters - hits);
+    for (i = 0; i < size; i++)
+	deletejob(&tab, 100000 + i);
+}
+
+/* bench_builtin - builtin dispatch, alone and behind eval (a line
+ *    run again comes from eval's cache of compiled lines) */
+static void bench_builtin(void)
+{
+    char line[] = "jobs\n", list[] = "false && jobs || true ; jobs\n";
+    char *argv[MAXARGS];
+    long long t0;
+    int i;
+
+    parseline(line, argv);
+    t0 = now_ns();
+    for (i = 0; i < iters; i++)
+	builtin_cmd(argv, 1);
+    report("builtin_cmd", "", iters, now_ns() - t0);
+
+    t0 = now_ns();
+    for (i = 0; i < iters; i++)
+	eval(line);
+    report("builtin_eval", "", iters, now_ns() - t0);
+
+    t0 = now_ns();
+    for (i = 0; i < iters; i++)
+	eval(list);
+    report("builtin_eval_list", "", iters, now_ns() - t0);
+}
+
+/* bench_spawn_reap - a foreground /bin/true from eval to reaped */
+static void bench_spawn_reap(void)
+{
+    char line[] = "/bin/true\n";
+    int i, n = iters / 100 > 0 ? iters / 100 : 1;
+    long long t0;
+
+    util_external = 1;
+    t0 = now_ns();
+    for (i = 0; i < n; i++)
+	eval(line);
+    report("spawn_reap", "", n, now_ns() - t0);
+    util_external = 0;
+
+    t0 = now_ns();
+    for (i = 0; i < iters; i++)
+	eval(line);
+    report("native_true", "", iters, now_ns() - t0);
+}
+
+/*
+ * bench_sigchld_burst - start <burst> background jobs, wait (without
+ *    reaping) until every one has exited, then time how long the event
+ *    loop takes to reap and delete them all.
+ */
+static void bench_sigchld_burst(void)
+{
+    char line[] = "/bin/true &\n";
+    struct job_t *job;
+    siginfo_t si;
+    char extra[64];
+    long long t0;
+    int i, jid;
+
+    util_external = 1;
+    for (i = 0; i < burst; i++)
+	eval(line);
+    util_external = 0;
+    for (jid = 1; jid <= maxjid(&jobs); jid++)
+	if ((job = getjobjid(&jobs, jid)) != NULL)
+	    waitid(P_PID, job->pid, &si, WEXITED | WNOWAIT);
+
+    snprintf(extra, sizeof(extra), "children=%d ", jobs.njobs);
+    t0 = now_ns();
+    while (jobs.njobs > 0)
+	ev_wait(-1);
+    report("sigchld_burst", extra, burst, now_ns() - t0);
+}
+
+/* bench_timers - deadline churn and expiry with <size> timers armed */
+static void nop_timer(struct wtimer_t *t, void *arg)
+{
+    (*(int *)arg)++;
+}
+
+static void bench_timers(int size)
+{
+    struct wtimer_t *t = (struct wtimer_t *)calloc(size + 1, sizeof(*t));
+    struct timespec ts = { 0, 5000000 };
+    char extra[64];
+    long long t0;
+    int i, fired = 0;
+
+    for (i = 0; i < size; i++)
+	tw_add(&t[i], 1000 + i % 60000, nop_timer, &fired);
+    snprintf(extra, sizeof(extra), "size=%d ", size);
+
+    t0 = now_ns();
+    for (i = 0; i < iters; i++) {
+	tw_add(&t[size], 1 + (i & 4095), nop_timer, &fired);
+	tw_del(&t[size]);
+    }
+    report("timer_add_del", extra, iters, now_ns() - t0);
+
+    /* all of them due within a few ms of each other */
+    for (i = 0; i < size; i++) {
+	tw_del(&t[i]);
+	tw_add(&t[i], 1 + i % 4, nop_timer, &fired);
+    }
+    nanosleep(&ts, NULL);
+    t0 = now_ns();
+    while (fired < size)
+	ev_wait(-1);
+    report("timer_expire", extra, size, now_ns() - t0);
+    free(t);
+}
+
+/* bench_history - append <size> lines, then !prefix lookups: a recent
+ *    one, the first old one (which builds the index) and old ones */
+static void bench_history(int size)
+{
+    char file[] = "/tmp/tsh-histXXXXXX", line[64], ev[32];
+    char extra[64];
+    long long t0;
+    int fd, i, n;
+
+    if ((fd = mkstemp(file)) < 0)
+	return;
+    close(fd);
+    t0 = now_ns();
+    if (history_open(file, HISTSIZE) < 0) {
+	unlink(file);
+	return;
+    }
+    snprintf(extra, sizeof(extra), "size=%d ", size);
+    report("history_open", extra, 1, now_ns() - t0);
+
+    t0 = now_ns();
+    for (i = 0; i < size; i++) {
+	n = snprintf(line, sizeof(line), "/bin/cmd%d --opt=%d\n", i % 20000, i);
+	history_add(line, n);
+    }
+    report("history_add", extra, size, now_ns() - t0);
+
+    t0 = now_ns();
+    for (i = 0; i < iters; i++) {
+	snprintf(ev, sizeof(ev), "!/bin/cmd%d\n", (size - 1 - i % 64) % 20000);
+	history_expand(ev);
+    }
+    report("history_recent", extra, iters, now_ns() - t0);
+
+    t0 = now_ns();
+    history_expand(strcpy(ev, "!/bin/cmd5000\n"));
+    report("history_index", extra, 1, now_ns() - t0);
+
+    t0 = now_ns();
+    for (i = 0; i < iters; i++) {
+	snprintf(ev, sizeof(ev), "!/bin/cmd%d\n", 2000 + i % 8000);
+	history_expand(ev);	/* not among the recent ones */
+    }
+    report("history_old", extra, iters, now_ns() - t0);
+    unlink(file);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-n <iters>] [-b <children>]\n", prog);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    int c, fd;
+
+    while ((c = getopt(argc, argv, "n:b:")) != EOF) {
+	switch (c) {
+	case 'n':
+	    iters = atoi(optarg);
+	    break;
+	case 'b':
+	    burst = atoi(optarg);
+	    break;
+	default:
+	    usage(argv[0]);
+	}
+    }
+    if (optind != argc || iters < 1 || burst < 1)
+	usage(argv[0]);
+
+    /* results on the real stdout; the shell's own output is discarded */
+    if ((fd = dup(1)) < 0 || (out = fdopen(fd, "w")) == NULL) {
+	perror("dup");
+	exit(1);
+    }
+    if ((fd = open("/dev/null", O_WRONLY)) >= 0) {
+	dup2(fd, 1);
+	close(fd);
+    }
+
+    tsh_init();
+
+    bench_parseline();
+    bench_tokenize();
+    bench_jobs(16);
+    bench_jobs(1000);
+    bench_jobs(10000);
+    bench_builtin();
+    bench_spawn_reap();
+    bench_sigchld_burst();
+    bench_timers(16);
+    bench_timers(1000);
+    bench_timers(100000);
+    bench_history(1000000);
+    exit(0);
+}
@@ -0,0 +1,88 @@
+#include "outring.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/uio.h>
+
+/**********************************
+ * Bounded buffers of job output
+ **********************************/
+
+struct outring_t *outring_new(int fd, size_t cap)
+{
+    struct outring_t *r;
+    size_t n;
+
+    for (n = 4096; n < cap; n *= 2)
+	;
+    if ((r = (struct outring_t *)malloc(sizeof(*r))) == NULL)
+	return NULL;
+    if ((r->buf = (char *)malloc(n)) == NULL) {
+	free(r);
+	return NULL;
+    }
+    r->fd = fd;
+    r->cap = n;
+    r->head = 0;
+    return r;
+}
+
+/*
+ * outring_fill - readv straight into the ring: the free run from head
+ *    to the end of the buffer, then the run from the start, which is
+ *    the oldest data and is simply overwritten. No bounce buffer.
+ */
+int outring_fill(struct outring_t *r)
+{
+    struct iovec iov[2];
+    size_t at;
+    ssize_t n;
+
+    for (;;) {
+	at = r->head & (r->cap - 1);
+	iov[0].iov_base = r->buf + at;
+	iov[0].iov_len = r->cap - at;
+	iov[1].iov_base = r->buf;
+	iov[1].iov_len = at;
+	if ((n = readv(r->fd, iov, at ? 2 : 1)) > 0) {
+	    r->head += n;
+	    continue;
+	}
+	if (n < 0 && errno == EINTR)
+	    continue;
+	if (n < 0 && errno == EAGAIN)
+	    return 1;
+	return 0;		/* EOF, or an error that will not go away */
+    }
+}
+
+unsigned long long outring_start(const struct outring_t *r)
+{
+    return r->head > r->cap ? r->head - r->cap : 0;
+}
+
+unsigned long long outring_print(const struct outring_t *r,
+				 unsigned long long from, FILE *fp)
+{
+    size_t at, len;
+
+    if (from < outring_start(r))
+	from = outring_start(r);
+    while (from < r->head) {
+	at = from & (r->cap - 1);
+	len = r->cap - at;
+	if (len > r->head - from)
+	    len = r->head - from;
+	fwrite(r->buf + at, 1, len, fp);
+	from += len;
+    }
+    return from;
+}
+
+void outring_free(struct outring_t *r)
+{
+    if (r->fd >= 0)
+	close(r->fd);
+    free(r->buf);
+    free(r);
+}
@@ -0,0 +1,43 @@
+//-*-c++-*-
+#ifndef _outring_h_
+#define _outring_h_
+
+#include <stdio.h>
+#include <stddef.h>
+
+/*
+ * A bounded ring buffer holding the latest output of a job. The job's
+ * stdout and stderr are a pipe whose read end the shell drains into
+ * the ring from the event loop; once more than cap bytes have come,
+ * the oldest are overwritten, so a chatty job costs the shell cap
+ * bytes and never blocks on a full pipe.
+ *
+ * Positions are byte counts since the job started: the ring holds
+ * [outring_start(r), r->head).
+ */
+struct outring_t {
+    int fd;                   /* read end of the job's pipe, -1 once closed */
+    char *buf;
+    size_t cap;               /* a power of two */
+    unsigned long long head;  /* bytes read so far */
+};
+
+/* outring_new - A ring of cap bytes (rounded up to a power of two)
+ *    fed from fd, which must be non-blocking; NULL if out of memory */
+struct outring_t *outring_new(int fd, size_t cap);
+
+/* outring_fill - Read what fd has ready; returns 0 once every writer
+ *    has closed it (the caller then closes fd), else 1 */
+int outring_fill(struct outring_t *r);
+
+/* outring_start - Position of the oldest byte still in the ring */
+unsigned long long outring_start(const struct outring_t *r);
+
+/* outring_print - Write the ring's bytes from position from (or the
+ *    oldest still held, if later) to fp; returns the new position */
+unsigned long long outring_print(const struct outring_t *r,
+				 unsigned long long from, FILE *fp);
+
+void outring_free(struct outring_t *r);  // closes fd too
+
+#endif
@@ -0,0 +1,265 @@
+#include "pathcache.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/*****************************************
+ * Cache of command name -> absolute path
+ *****************************************/
+
+#define DEFPATH "/bin:/usr/bin"  /* used when $PATH is unset */
+
+struct pathdir_t {           /* one $PATH component */
+    char *dir;
+    struct timespec mtime;   /* when its entries were cached */
+    int valid;               /* mtime has been read */
+};
+
+struct pathent_t {           /* one cached command */
+    char *name;
+    char *path;              /* dir + "/" + name */
+    int dir;                 /* index into dirs[] */
+    int hits;
+    struct pathent_t *next;  /* hash chain */
+};
+
+static char *pathstr;              /* the $PATH dirs[] was built from */
+static struct pathdir_t *dirs;
+static int ndirs;
+static struct pathent_t **buckets;
+static unsigned nbuckets, nents;
+
+/* strhash - FNV-1a */
+static unsigned strhash(const char *s)
+{
+    unsigned h = 2166136261u;
+
+    while (*s)
+	h = (h ^ (unsigned char)*s++) * 16777619u;
+    return h;
+}
+
+/* dropents - Forget every entry found in dirs[from] or later */
+static void dropents(int from)
+{
+    struct pathent_t **pp, *e;
+    unsigned i;
+
+    for (i = 0; i < nbuckets; i++) {
+	for (pp = &buckets[i]; (e = *pp) != NULL; ) {
+	    if (e->dir >= from) {
+		*pp = e->next;
+		free(e->name);
+		free(e->path);
+		free(e);
+		nents--;
+	    }
+	    else
+		pp = &e->next;
+	}
+    }
+}
+
+/* freedirs - Forget dirs[] and the $PATH it came from */
+static void freedirs(void)
+{
+    int n;
+
+    for (n = 0; n < ndirs; n++)
+	free(dirs[n].dir);
+    free(dirs);
+    free(pathstr);
+    dirs = NULL;
+    pathstr = NULL;
+    ndirs = 0;
+}
+
+/*
+ * loadpath - (Re)split $PATH into dirs[] if it changed. Returns -1
+ *    if out of memory, with nothing cached so the next call starts
+ *    over.
+ */
+static int loadpath(void)
+{
+    const char *path = getenv("PATH");
+    char *p, *dir, *colon;
+    int n;
+
+    if (path == NULL)
+	path = DEFPATH;
+    if (pathstr != NULL && strcmp(path, pathstr) == 0)
+	return 0;
+
+    if (buckets != NULL)
+	dropents(0);
+    freedirs();
+
+    if (buckets == NULL) {
+	if ((buckets = (struct pathent_t **)calloc(64, sizeof(struct pathent_t *))) == NULL)
+	    return -1;
+	nbuckets = 64;
+    }
+
+    if ((p = strdup(path)) == NULL)
+	return -1;
+    for (n = 1, dir = p; *dir; dir++)
+	if (*dir == ':')
+	    n++;
+    if ((dirs = (struct pathdir_t *)calloc(n, sizeof(struct pathdir_t))) == NULL) {
+	free(p);
+	return -1;
+    }
+    for (ndirs = 0, dir = p; ndirs < n; ndirs++, dir = colon + 1) {
+	if ((colon = strchr(dir, ':')) != NULL)
+	    *colon = '\0';
+	/* An empty component means the current directory */
+	if ((dirs[ndirs].dir = strdup(*dir ? dir : ".")) == NULL) {
+	    free(p);
+	    freedirs();
+	    return -1;
+	}
+    }
+    free(p);
+    if ((pathstr = strdup(path)) == NULL) {
+	freedirs();
+	return -1;
+    }
+    return 0;
+}
+
+/*
+ * checkdir - Return 1 if dirs[i] is unchanged since its entries
+ *    were cached. Otherwise record the new mtime, drop the entries it
+ *    may have invalidated and return 0.
+ */
+static int checkdir(int i)
+{
+    struct stat sb;
+
+    if (stat(dirs[i].dir, &sb) < 0)
+	memset(&sb, 0, sizeof(sb));
+    if (dirs[i].valid &&
+	sb.st_mtim.tv_sec == dirs[i].mtime.tv_sec &&
+	sb.st_mtim.tv_nsec == dirs[i].mtime.tv_nsec)
+	return 1;
+    /* A new file here may shadow commands found further down $PATH */
+    dropents(i);
+    dirs[i].mtime = sb.st_mtim;
+    dirs[i].valid = 1;
+    return 0;
+}
+
+/* grow - Double the bucket array, or leave it be if out of memory */
+static void grow(void)
+{
+    struct pathent_t **old = buckets, *e, *next;
+    unsigned oldn = nbuckets, i, h;
+
+    if ((buckets = (struct pathent_t **)calloc(2 * nbuckets, sizeof(struct pathent_t *))) == NULL) {
+	buckets = old;
+	return;
+    }
+    nbuckets *= 2;
+    for (i = 0; i < oldn; i++) {
+	for (e = old[i]; e != NULL; e = next) {
+	    next = e->next;
+	    h = strhash(e->name) & (nbuckets - 1);
+	    e->next = buckets[h];
+	    buckets[h] = e;
+	}
+    }
+    free(old);
+}
+
+/*
+ * pathcache_lookup - Return the file to execute for command name, or
+ *    NULL if it is not found on $PATH (or there is no memory to
+ *    look). Names containing a '/' are returned as is. The result is
+ *    valid until the next call.
+ */
+const char *pathcache_lookup(const char *name)
+{
+    struct pathent_t *e;
+    struct stat sb;
+    unsigned h;
+    size_t len;
+    char *path;
+    int i;
+
+    if (strchr(name, '/') != NULL)
+	return name;
+    if (loadpath() < 0)
+	return NULL;
+
+    h = strhash(name);
+    for (e = buckets[h & (nbuckets - 1)]; e != NULL; e = e->next)
+	if (strcmp(e->name, name) == 0)
+	    break;
+    if (e != NULL) {
+	for (i = 0; i <= e->dir; i++)
+	    if (!checkdir(i))
+		break;
+	if (i > e->dir) {
+	    e->hits++;
+	    return e->path;
+	}
+	/* e was freed by checkdir; fall through and search again */
+    }
+
+    for (i = 0; i < ndirs; i++) {
+	checkdir(i);
+	len = strlen(dirs[i].dir) + strlen(name) + 2;
+	if ((path = (char *)malloc(len)) == NULL)
+	    return NULL;
+	snprintf(path, len, "%s/%s", dirs[i].dir, name);
+	if (stat(path, &sb) == 0 && S_ISREG(sb.st_mode) &&
+	    access(path, X_OK) == 0) {
+	    if (2 * nents >= nbuckets)
+		grow();
+	    if ((e = (struct pathent_t *)malloc(sizeof(struct pathent_t))) == NULL ||
+		(e->name = strdup(name)) == NULL) {
+		free(e);
+		free(path);
+		return NULL;
+	    }
+	    e->path = path;
+	    e->dir = i;
+	    e->hits = 1;
+	    e->next = buckets[h & (nbuckets - 1)];
+	    buckets[h & (nbuckets - 1)] = e;
+	    nents++;
+	    return e->path;
+	}
+	free(path);
+    }
+    return NULL;
+}
+
+/* pathcache_reset - Forget every cached command */
+void pathcache_reset(void)
+{
+    int i;
+
+    if (buckets != NULL)
+	dropents(0);
+    for (i = 0; i < ndirs; i++)
+	dirs[i].valid = 0;
+}
+
+/* pathcache_list - Print the cache the way bash's hash builtin does */
+void pathcache_list(void)
+{
+    struct pathent_t *e;
+    unsigned i;
+
+    if (nents == 0) {
+	printf("hash: hash table empty\n");
+	return;
+    }
+    printf("hits\tcommand\n");
+    for (i = 0; i < nbuckets; i++)
+	for (e = buckets[i]; e != NULL; e = e->next)
+	    printf("%4d\t%s\n", e->hits, e->path);
+}
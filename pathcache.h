@@ -0,0 +1,16 @@
+//-*-c++-*-
+#ifndef _pathcache_h_
+#define _pathcache_h_
+
+/*
+ * $PATH resolution with a cache of command name -> absolute path.
+ * A cached entry is trusted as long as the directory it was found in,
+ * and every directory ahead of it in $PATH, still has the mtime it
+ * had when the entry was made; adding or removing a file changes the
+ * directory's mtime and drops the affected entries.
+ */
+const char *pathcache_lookup(const char *name);
+void pathcache_reset(void);
+void pathcache_list(void);
+
+#endif
@@ -0,0 +1,114 @@
+#include "place.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+/****************************
+ * CPU placement of jobs
+ ****************************/
+
+int place_policy = PLACE_NONE;
+
+static int cpus[CPU_SETSIZE];  /* the CPUs the shell may use, in order */
+static int ncpus;
+static int load[CPU_SETSIZE];  /* jobs pinned to each CPU, by number */
+static int last = -1;          /* index in cpus[] last given out */
+
+int place_setpolicy(const char *name)
+{
+    static const char *names[] = { "none", "roundrobin", "packed" };
+    cpu_set_t set;
+    int p, i;
+
+    for (p = 0; p < 3 && strcmp(name, names[p]) != 0; p++)
+	;
+    if (p == 3)
+	return -1;
+    if (p != PLACE_NONE && ncpus == 0) {
+	if (sched_getaffinity(0, sizeof(set), &set) < 0)
+	    return -1;
+	for (i = 0; i < CPU_SETSIZE; i++)
+	    if (CPU_ISSET(i, &set))
+		cpus[ncpus++] = i;
+    }
+    place_policy = p;
+    return 0;
+}
+
+/* place_pick - Scan from the CPU after the last one given out
+ *    (roundrobin) or from the first (packed); the first CPU with
+ *    the fewest jobs wins */
+int place_pick(void)
+{
+    int i, k, best = -1;
+
+    if (place_policy == PLACE_NONE || ncpus == 0)
+	return -1;
+    for (i = 0; i < ncpus; i++) {
+	k = place_policy == PLACE_ROUNDROBIN ? (last + 1 + i) % ncpus : i;
+	if (best < 0 || load[cpus[k]] < load[cpus[best]]) {
+	    best = k;
+	    if (load[cpus[k]] == 0)
+		break;		/* an idle CPU: none can beat it */
+	}
+    }
+    last = best;
+    load[cpus[best]]++;
+    return cpus[best];
+}
+
+void place_release(int cpu)
+{
+    if (cpu >= 0 && cpu < CPU_SETSIZE && load[cpu] > 0)
+	load[cpu]--;
+}
+
+int cpus_parse(const char *s, cpu_set_t *set)
+{
+    char *end;
+    long lo, hi;
+
+    CPU_ZERO(set);
+    for (;;) {
+	if (!isdigit((unsigned char)*s))
+	    return -1;
+	lo = hi = strtol(s, &end, 10);
+	if (*end == '-') {
+	    if (!isdigit((unsigned char)end[1]))
+		return -1;
+	    hi = strtol(end + 1, &end, 10);
+	}
+	if (lo > hi || hi >= CPU_SETSIZE)
+	    return -1;
+	for (; lo <= hi; lo++)
+	    CPU_SET(lo, set);
+	if (*end == '\0')
+	    return 0;
+	if (*end != ',')
+	    return -1;
+	s = end + 1;
+    }
+}
+
+/* cpus_format - Runs of three or more CPUs become lo-hi */
+char *cpus_format(const cpu_set_t *set, char *buf, size_t size)
+{
+    size_t len = 0;
+    int lo, hi;
+
+    buf[0] = '\0';
+    for (lo = 0; lo < CPU_SETSIZE && len < size; lo = hi + 1) {
+	hi = lo;
+	if (!CPU_ISSET(lo, set))
+	    continue;
+	while (hi + 1 < CPU_SETSIZE && CPU_ISSET(hi + 1, set))
+	    hi++;
+	if (hi == lo)
+	    len += snprintf(buf + len, size - len, "%s%d", len ? "," : "", lo);
+	else
+	    len += snprintf(buf + len, size - len, "%s%d%c%d", len ? "," : "", lo,
+			    hi == lo + 1 ? ',' : '-', hi);
+    }
+    return buf;
+}
@@ -0,0 +1,74 @@
+//-*-c++-*-
+#ifndef _place_h_
+#define _place_h_
+
+#include <sched.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/resource.h>
+
+/*
+ * Where a child runs: the CPUs it may use and its nice value, each
+ * set only if its bit is in flags (otherwise it keeps the shell's).
+ * Applied by the launch routines (launch.h) in the child before it
+ * execs; posix_spawn has no attribute for either, so a placed child
+ * is always forked.
+ */
+#define PL_CPUS 1
+#define PL_NICE 2
+
+struct place_t {
+    int flags;          /* PL_CPUS, PL_NICE */
+    int nice;
+    cpu_set_t cpus;
+};
+
+/* place_apply - Give process pid (0: the caller) what pl says; -1
+ *    with errno set if the kernel refuses either */
+static inline int place_apply(pid_t pid, const struct place_t *pl)
+{
+    if ((pl->flags & PL_CPUS) && sched_setaffinity(pid, sizeof(pl->cpus), &pl->cpus) < 0)
+	return -1;
+    if ((pl->flags & PL_NICE) && setpriority(PRIO_PROCESS, pid, pl->nice) < 0)
+	return -1;
+    return 0;
+}
+
+/*
+ * Placement policy for background jobs (tsh -a). The shell counts
+ * the jobs it has pinned to each CPU it may use (its own affinity
+ * when the policy is set) and pins each new background job to one
+ * of the least loaded ones, so a batch spreads over idle CPUs
+ * instead of wherever the kernel first puts it:
+ *
+ *   PLACE_NONE        leave it to the kernel (the default)
+ *   PLACE_ROUNDROBIN  the first least loaded CPU after the last one
+ *                     given out, so successive jobs go round them all
+ *   PLACE_PACKED      the lowest-numbered least loaded CPU, so jobs
+ *                     fill neighbouring CPUs (and their shared caches)
+ *                     and leave the others idle
+ *
+ * A job holds its CPU until it leaves the job list.
+ */
+#define PLACE_NONE       0
+#define PLACE_ROUNDROBIN 1
+#define PLACE_PACKED     2
+
+extern int place_policy;
+
+/* place_setpolicy - Set the policy by name; -1 if there is no such
+ *    policy or the shell's CPUs cannot be found */
+int place_setpolicy(const char *name);
+
+/* place_pick - A CPU for a new job, counted against it until
+ *    place_release; -1 under PLACE_NONE */
+int place_pick(void);
+void place_release(int cpu);
+
+/* cpus_parse - "0-3,8,10-11" into set; -1 if malformed or empty */
+int cpus_parse(const char *s, cpu_set_t *set);
+
+/* cpus_format - set as a list like cpus_parse takes, in buf */
+char *cpus_format(const cpu_set_t *set, char *buf, size_t size);
+
+#endif
@@ -0,0 +1,46 @@
+#include "procfd.h"
+#include <signal.h>
+#include <unistd.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <sys/syscall.h>
+
+/*******************************
+ * Process file descriptors
+ *******************************/
+
+#ifndef PIDFD_SIGNAL_PROCESS_GROUP
+#define PIDFD_SIGNAL_PROCESS_GROUP (1U << 2)   /* Linux 6.9 */
+#endif
+
+int procfd_open(pid_t pid)
+{
+    return syscall(SYS_pidfd_open, pid, 0);
+}
+
+int procfd_kill(int pidfd, int sig)
+{
+    return syscall(SYS_pidfd_send_signal, pidfd, sig, NULL,
+		   PIDFD_SIGNAL_PROCESS_GROUP);
+}
+
+/*
+ * procfd_reap - The waitid system call itself, not the libc wrapper:
+ *    only the former hands back the child's rusage, which the job
+ *    statistics are made of.
+ */
+pid_t procfd_reap(int pidfd, int *status, struct rusage *ru)
+{
+    siginfo_t si;
+
+    memset(&si, 0, sizeof(si));
+    if (syscall(SYS_waitid, P_PIDFD, pidfd, &si, WEXITED | WNOHANG, ru) < 0)
+	return -1;
+    if (si.si_pid == 0)
+	return 0;
+    if (si.si_code == CLD_EXITED)
+	*status = W_EXITCODE(si.si_status, 0);
+    else
+	*status = W_EXITCODE(0, si.si_status) | (si.si_code == CLD_DUMPED ? WCOREFLAG : 0);
+    return si.si_pid;
+}
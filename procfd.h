@@ -0,0 +1,28 @@
+//-*-c++-*-
+#ifndef _procfd_h_
+#define _procfd_h_
+
+#include <sys/types.h>
+#include <sys/resource.h>
+
+/*
+ * Process file descriptors (pidfds). A pidfd names one process for as
+ * long as it is open, even after the process has died, so signals
+ * sent through it can never reach a stranger that was given a
+ * recycled PID. It becomes readable when the process exits, which
+ * lets the event loop wait for children like any other descriptor.
+ * Each call returns -1 with errno set on failure (ENOSYS on kernels
+ * without pidfds); the descriptors are close-on-exec.
+ */
+int procfd_open(pid_t pid);
+
+/* procfd_kill - Send sig to the whole process group of the process
+ *    (EINVAL if the kernel cannot signal a group through a pidfd). */
+int procfd_kill(int pidfd, int sig);
+
+/* procfd_reap - Reap the process if it has exited: returns its PID
+ *    and fills in a wait(2)-style *status and its rusage, 0 if it is
+ *    still running. */
+pid_t procfd_reap(int pidfd, int *status, struct rusage *ru);
+
+#endif
@@ -33,6 +33,7 @@ use IPC::Open2;
 #     CLOSE       Close Writer (sends EOF signal to child)
 #     WAIT        Wait() for child to terminate
 #     SLEEP <n>   Sleep for <n> seconds
+#     SLEEP <n>ms Sleep for <n> milliseconds
 # 
 ######################################################################
 
@@ -171,6 +172,14 @@ while (<INFILE>) {
 	}
     }
 
+    # Sleep for milliseconds
+    elsif ($line =~ /SLEEP (\d+)ms/) {
+	if ($verbose) {
+	    print "$0: Sleeping $1 msecs\n";
+	}
+	select(undef, undef, undef, $1 / 1000);
+    }
+
     # Sleep
     elsif ($line =~ /SLEEP (\d+)/) {
 	if ($verbose) {
@@ -0,0 +1,111 @@
+#include "strpool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/********************************
+ * Pool of interned strings
+ ********************************/
+
+struct strent_t {           /* header stored just ahead of the text */
+    struct strent_t *next;  /* hash chain */
+    unsigned hash;
+    unsigned refs;
+    size_t len;
+    char text[1];           /* len bytes plus a NUL */
+};
+
+static struct strent_t **buckets;
+static unsigned nbuckets, nents;
+static size_t nbytes;
+
+/* strhash - FNV-1a over len bytes */
+static unsigned strhash(const char *s, size_t len)
+{
+    unsigned h = 2166136261u;
+
+    while (len-- > 0)
+	h = (h ^ (unsigned char)*s++) * 16777619u;
+    return h;
+}
+
+/* grow - Double the bucket array; -1 (keeping the old one) if out
+ *    of memory */
+static int grow(void)
+{
+    struct strent_t **old = buckets, *e, *next;
+    unsigned oldn = nbuckets, i, n = nbuckets ? 2 * nbuckets : 64;
+
+    if ((buckets = (struct strent_t **)calloc(n, sizeof(struct strent_t *))) == NULL) {
+	buckets = old;
+	return -1;
+    }
+    nbuckets = n;
+    for (i = 0; i < oldn; i++) {
+	for (e = old[i]; e != NULL; e = next) {
+	    next = e->next;
+	    e->next = buckets[e->hash & (nbuckets - 1)];
+	    buckets[e->hash & (nbuckets - 1)] = e;
+	}
+    }
+    free(old);
+    return 0;
+}
+
+/*
+ * str_intern - Return the pooled copy of s[0..len), adding it if it
+ *    is new. Each call takes a reference; drop it with str_release.
+ *    Returns NULL if out of memory.
+ */
+const char *str_intern(const char *s, size_t len)
+{
+    unsigned h = strhash(s, len);
+    struct strent_t *e;
+
+    /* a full table still works, with longer chains */
+    if (2 * nents >= nbuckets && grow() < 0 && buckets == NULL)
+	return NULL;
+    for (e = buckets[h & (nbuckets - 1)]; e != NULL; e = e->next) {
+	if (e->hash == h && e->len == len && memcmp(e->text, s, len) == 0) {
+	    e->refs++;
+	    return e->text;
+	}
+    }
+
+    if ((e = (struct strent_t *)malloc(offsetof(struct strent_t, text) + len + 1)) == NULL)
+	return NULL;
+    memcpy(e->text, s, len);
+    e->text[len] = '\0';
+    e->hash = h;
+    e->refs = 1;
+    e->len = len;
+    e->next = buckets[h & (nbuckets - 1)];
+    buckets[h & (nbuckets - 1)] = e;
+    nents++;
+    nbytes += offsetof(struct strent_t, text) + len + 1;
+    return e->text;
+}
+
+/* str_release - Drop a reference taken by str_intern */
+void str_release(const char *s)
+{
+    struct strent_t *e, **pp;
+
+    if (s == NULL)
+	return;
+    e = (struct strent_t *)(s - offsetof(struct strent_t, text));
+    if (--e->refs > 0)
+	return;
+    for (pp = &buckets[e->hash & (nbuckets - 1)]; *pp != e; pp = &(*pp)->next)
+	;
+    *pp = e->next;
+    nents--;
+    nbytes -= offsetof(struct strent_t, text) + e->len + 1;
+    free(e);
+}
+
+/* str_bytes - Bytes currently allocated for pooled strings */
+size_t str_bytes(void)
+{
+    return nbytes;
+}
@@ -0,0 +1,16 @@
+//-*-c++-*-
+#ifndef _strpool_h_
+#define _strpool_h_
+
+#include <stddef.h>
+
+/*
+ * Interned, reference-counted strings. Each distinct string is
+ * stored once, in an allocation sized to its length, so a thousand
+ * jobs started from the same command line share one copy of it.
+ */
+const char *str_intern(const char *s, size_t len);
+void str_release(const char *s);
+size_t str_bytes(void);   // bytes held by the pool, for diagnostics
+
+#endif
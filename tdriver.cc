@@ -0,0 +1,604 @@
+/*
+ * tdriver.c - Parallel trace driver for the tiny shell
+ *
+ * usage: tdriver [-hv] [-s <shell>] [-a <args>] [-j <n>] [-r <ref>]
+ *                <trace> ...
+ *
+ * Runs the same trace files as sdriver.pl, with the same driver
+ * commands (TSTP, INT, QUIT, KILL, CLOSE, WAIT, SLEEP <n>) plus
+ * "SLEEP <n>ms" for millisecond sleeps. Instead of one trace at a
+ * time, up to <n> traces (default: all of them) run at once, each
+ * with its own shell in its own session, with a fresh pseudo-terminal
+ * as controlling terminal so "/bin/ps a" in one trace can be told
+ * apart from the others. The shell's stdin is a pipe, as with
+ * sdriver.pl, but its stdout and stderr are one memfd, not a pipe:
+ * a file, so the shell's stdio buffers its output fully and writes
+ * from the shell and its children land in the order they are made,
+ * never blocking on a full pipe. A trace's output is laid out exactly
+ * as sdriver.pl prints it: comment lines as they are read, then
+ * everything the shell wrote.
+ *
+ * Without -r, the outputs are printed in the order the traces were
+ * given. With -r, each output is compared with that trace's section
+ * of a reference file in "make tests" format (e.g. tshref.out) and
+ * only the differences are printed. A trace with an expected output
+ * file of its own (trace17.out for trace17.txt) is compared with that
+ * instead, so traces of tsh's own features need no section in the
+ * reference shell's output. Before comparing, PIDs in parentheses are
+ * replaced by "(PID)", timings like "1.234s" by "#.###s" (and the
+ * figures of a time or parallel report by "#"), and "/bin/ps a"
+ * listings are reduced to the STAT and COMMAND of the processes
+ * started by the trace, with the shell's own command line shortened
+ * to "tsh". The exit status is the number of traces that differed.
+ */
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+
+#define MAXLINE 1024
+#define MAXSARGS 32
+
+/* One trace file and what happened when it ran */
+struct trace_t {
+    const char *file;
+    pid_t runner;		/* process running the trace, 0 when done */
+    int outfd;			/* memfd holding its output */
+    long long start, ns;	/* when it started, how long it took */
+};
+
+static const char *shell = "./tsh";
+static char *shellargv[MAXSARGS];
+static int verbose;
+
+/* now_ns - monotonic clock in nanoseconds */
+static long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static void unix_error(const char *msg)
+{
+    fprintf(stderr, "%s: %s\n", msg, strerror(errno));
+    exit(127);
+}
+
+/* xrealloc - realloc that gives up on the whole run if out of memory */
+static void *xrealloc(void *p, size_t size)
+{
+    if ((p = realloc(p, size)) == NULL)
+	unix_error("realloc error");
+    return p;
+}
+
+/* writeall - write all of buf to fd */
+static void writeall(int fd, const char *buf, size_t len)
+{
+    ssize_t n;
+
+    while (len > 0) {
+	if ((n = write(fd, buf, len)) < 0) {
+	    if (errno == EINTR)
+		continue;
+	    return;
+	}
+	buf += n;
+	len -= n;
+    }
+}
+
+/* readall - the whole contents of fd from offset 0, NUL terminated */
+static char *readall(int fd)
+{
+    size_t len = 0, cap = 4096;
+    char *buf = (char *)xrealloc(NULL, cap);
+    ssize_t n;
+
+    while ((n = pread(fd, buf + len, cap - len - 1, len)) > 0) {
+	len += n;
+	if (len + 1 == cap)
+	    buf = (char *)xrealloc(buf, cap *= 2);
+    }
+    buf[len] = '\0';
+    return buf;
+}
+
+/*
+ * start_shell - run the shell on a pipe in its own session, with a new
+ *    pseudo-terminal (if one can be had) as its controlling terminal.
+ *    Its stdout and stderr go to outfd. Returns the shell's pid and
+ *    the write end of its stdin in *infd, and the pty master in *ptyfd.
+ */
+static pid_t start_shell(int outfd, int *infd, int *ptyfd, char *tty)
+{
+    int in[2], slave;
+    const char *name;
+    pid_t pid;
+
+    *ptyfd = -1;
+    tty[0] = '\0';
+    if ((*ptyfd = posix_openpt(O_RDWR | O_NOCTTY | O_CLOEXEC)) >= 0) {
+	if (grantpt(*ptyfd) < 0 || unlockpt(*ptyfd) < 0 ||
+	    (name = ptsname(*ptyfd)) == NULL) {
+	    close(*ptyfd);
+	    *ptyfd = -1;
+	}
+	else
+	    snprintf(tty, 32, "%s", name + strlen("/dev/"));
+    }
+
+    if (pipe2(in, O_CLOEXEC) < 0)
+	unix_error("pipe error");
+    if ((pid = fork()) < 0)
+	unix_error("fork error");
+    if (pid == 0) {
+	setsid();
+	if (tty[0] != '\0' && (slave = open(ptsname(*ptyfd), O_RDWR)) >= 0)
+	    close(slave);	/* still our controlling terminal */
+	dup2(in[0], 0);
+	dup2(outfd, 1);
+	dup2(outfd, 2);
+	signal(SIGPIPE, SIG_DFL);
+	execv(shell, shellargv);
+	fprintf(stderr, "%s: %s\n", shell, strerror(errno));
+	_exit(127);
+    }
+    close(in[0]);
+    *infd = in[1];
+    return pid;
+}
+
+/*
+ * run_trace - carry out one trace file against a fresh shell, writing
+ *    what sdriver.pl would print to fd 1. Runs in its own process.
+ */
+static int run_trace(const char *file)
+{
+    char line[MAXLINE], tty[32], *p;
+    int infd, ptyfd, shellout, status;
+    struct timespec ts;
+    pid_t pid;
+    long n;
+    FILE *fp;
+
+    if ((fp = fopen(file, "r")) == NULL) {
+	fprintf(stderr, "tdriver: ERROR: %s: %s\n", file, strerror(errno));
+	return 1;
+    }
+    if ((shellout = memfd_create("shell", MFD_CLOEXEC)) < 0)
+	unix_error("memfd_create error");
+    pid = start_shell(shellout, &infd, &ptyfd, tty);
+    if (tty[0] != '\0') {	/* for check(), ahead of the output proper */
+	snprintf(line, sizeof(line), "tty=%s\n", tty);
+	writeall(1, line, strlen(line));
+    }
+
+    while (fgets(line, sizeof(line), fp) != NULL) {
+	if (line[0] == '#') {
+	    writeall(1, line, strlen(line));
+	    continue;
+	}
+	for (p = line; isspace((unsigned char)*p); p++)
+	    ;
+	if (*p == '\0')
+	    continue;
+
+	if (strncmp(p, "TSTP", 4) == 0)
+	    kill(pid, SIGTSTP);
+	else if (strncmp(p, "INT", 3) == 0)
+	    kill(pid, SIGINT);
+	else if (strncmp(p, "QUIT", 4) == 0)
+	    kill(pid, SIGQUIT);
+	else if (strncmp(p, "KILL", 4) == 0)
+	    kill(pid, SIGKILL);
+	else if (strncmp(p, "CLOSE", 5) == 0) {
+	    if (infd >= 0)
+		close(infd);
+	    infd = -1;
+	}
+	else if (strncmp(p, "WAIT", 4) == 0)
+	    waitpid(pid, NULL, 0);
+	else if (strncmp(p, "SLEEP ", 6) == 0) {
+	    n = strtol(p + 6, &p, 10);
+	    if (strncmp(p, "ms", 2) != 0)
+		n *= 1000;
+	    ts.tv_sec = n / 1000;
+	    ts.tv_nsec = (n % 1000) * 1000000;
+	    while (nanosleep(&ts, &ts) < 0 && errno == EINTR)
+		;
+	}
+	else {
+	    if (verbose)
+		fprintf(stderr, "%s: sending :%.*s: to %d\n",
+			file, (int)strcspn(line, "\n"), line, (int)pid);
+	    if (infd >= 0)
+		writeall(infd, line, strlen(line));
+	}
+    }
+    fclose(fp);
+
+    /* as sdriver.pl: close the shell's stdin, then print its output */
+    if (infd >= 0)
+	close(infd);
+    waitpid(pid, &status, 0);
+    p = readall(shellout);
+    writeall(1, p, strlen(p));
+    free(p);
+    if (ptyfd >= 0)
+	close(ptyfd);
+    return 0;
+}
+
+/* Reference output and comparison */
+
+/* Lines of the report of time and parallel, whose values vary */
+static const char *timed[] = {
+    "real\t", "user\t", "sys\t", "maxrss\t", "ctxsw\t", "cpu/real\t", NULL
+};
+
+/* Processes of the test harness itself, left out of "ps a" listings */
+static const char *harness[] = {
+    "-", "make", "/bin/sh -c", "perl ", "./tdriver", "tdriver", NULL
+};
+
+/*
+ * normalize - rewrite one line of output into the form that is
+ *    compared, in place. Returns 0 if the line should be skipped.
+ *    tty, if not NULL, is the terminal whose "ps a" lines to keep.
+ */
+static int normalize(char *line, const char *tty)
+{
+    char *p, *q, *stat, *cmd, ttyname[32];
+    int pid, i, off = 0;
+
+    /* "ps a" output: keep "ps: <STAT> <COMMAND>" for the trace's own */
+    if (strstr(line, "PID TTY") != NULL && strstr(line, "COMMAND") != NULL)
+	return 0;
+    if (sscanf(line, " %d %31s %n", &pid, ttyname, &off) == 2 && off > 0 &&
+	(strncmp(ttyname, "pts/", 4) == 0 || strncmp(ttyname, "tty", 3) == 0 ||
+	 strcmp(ttyname, "?") == 0)) {
+	if (tty != NULL && strcmp(ttyname, tty) != 0)
+	    return 0;
+	stat = line + off;
+	for (p = stat; *p != '\0' && !isspace((unsigned char)*p); p++)
+	    ;
+	for (cmd = p; isspace((unsigned char)*cmd); cmd++)
+	    ;
+	for (; *cmd != '\0' && !isspace((unsigned char)*cmd); cmd++)
+	    ;			/* skip TIME */
+	for (; isspace((unsigned char)*cmd); cmd++)
+	    ;
+	for (i = 0; harness[i] != NULL; i++)
+	    if (strncmp(cmd, harness[i], strlen(harness[i])) == 0)
+		return 0;
+	if (strncmp(cmd, "/bin/ps", 7) == 0)
+	    return 0;		/* running, but may not be scheduled yet */
+	if (strncmp(cmd, "./tsh ", 6) == 0 ||
+	    (strncmp(cmd, shell, strlen(shell)) == 0 && cmd[strlen(shell)] == ' '))
+	    strcpy(cmd, "tsh");	/* the shell, whatever its path and -a */
+	memmove(line, "ps: ", 4);
+	/* stopped or not; R vs. S is down to scheduling */
+	line[4] = (*stat == 'T' || *stat == 't') ? 'T' : 'S';
+	line[5] = ' ';
+	memmove(line + 6, cmd, strlen(cmd) + 1);
+	return 1;
+    }
+
+    /* "real\t0m1.234s" -> "real\t#" */
+    for (i = 0; timed[i] != NULL; i++)
+	if (strncmp(line, timed[i], strlen(timed[i])) == 0) {
+	    strcpy(line + strlen(timed[i]), "#");
+	    return 1;
+	}
+
+    /* "(12345)" -> "(PID)", "1.234s" -> "#.###s" */
+    for (p = q = line; *p != '\0'; ) {
+	if (isdigit((unsigned char)*p) && (p == line || !isalnum((unsigned char)p[-1]))) {
+	    for (i = 1; isdigit((unsigned char)p[i]); i++)
+		;
+	    if (p[i] == '.' && isdigit((unsigned char)p[i + 1]) &&
+		isdigit((unsigned char)p[i + 2]) && isdigit((unsigned char)p[i + 3]) &&
+		p[i + 4] == 's' && !isalnum((unsigned char)p[i + 5])) {
+		memcpy(q, "#.###s", 6);
+		q += 6;
+		p += i + 5;
+		continue;
+	    }
+	}
+	if (*p == '(' && isdigit((unsigned char)p[1])) {
+	    for (i = 1; isdigit((unsigned char)p[i]); i++)
+		;
+	    if (p[i] == ')') {
+		memcpy(q, "(PID)", 5);
+		q += 5;
+		p += i + 1;
+		continue;
+	    }
+	}
+	*q++ = *p++;
+    }
+    *q = '\0';
+    return 1;
+}
+
+/* splitlines - normalized lines of text, in a NULL terminated array */
+static char **splitlines(char *text, const char *tty, int *nlines)
+{
+    int n = 0, cap = 64;
+    char **v = (char **)xrealloc(NULL, cap * sizeof(char *));
+    char *p, *nl;
+
+    for (p = text; *p != '\0'; p = nl + 1) {
+	if ((nl = strchr(p, '\n')) == NULL)
+	    nl = p + strlen(p) - 1;
+	else
+	    *nl = '\0';
+	if (!normalize(p, tty))
+	    continue;
+	if (n + 1 >= cap)
+	    v = (char **)xrealloc(v, (cap *= 2) * sizeof(char *));
+	v[n++] = p;
+	if (nl[1] == '\0')
+	    break;
+    }
+    v[n] = NULL;
+    *nlines = n;
+    return v;
+}
+
+/*
+ * refsection - the reference output for a trace: the lines after the
+ *    "... -t <trace> ..." line up to the next such line or make's own
+ *    chatter. Returns a malloc'ed copy, or NULL if there is none.
+ */
+static char *refsection(const char *ref, const char *file)
+{
+    const char *base = strrchr(file, '/') ? strrchr(file, '/') + 1 : file;
+    const char *p, *start = NULL, *end;
+    char key[256];
+
+    snprintf(key, sizeof(key), " -t %s ", base);
+    for (p = ref; *p != '\0'; p = end + 1) {
+	if ((end = strchr(p, '\n')) == NULL)
+	    end = p + strlen(p) - 1;
+	if (start == NULL) {
+	    if (memmem(p, end - p, key, strlen(key)) != NULL)
+		start = end + 1;
+	}
+	else if (strncmp(p, "make", 4) == 0 ||
+		 (!isspace((unsigned char)*p) && !isdigit((unsigned char)*p) &&
+		  memmem(p, end - p, " -t ", 4) != NULL))
+	    return strndup(start, p - start);
+	if (end[1] == '\0')
+	    break;
+    }
+    return start != NULL ? strdup(start) : NULL;
+}
+
+/*
+ * expected - the output wanted from a trace: its own .out file if it
+ *    has one, else its section of ref (NULL if there is no ref).
+ */
+static char *expected(const char *ref, const char *file)
+{
+    char name[MAXLINE];
+    const char *dot = strrchr(file, '.');
+    char *want;
+    int fd;
+
+    snprintf(name, sizeof(name), "%.*s.out",
+	     (int)(dot != NULL ? dot - file : (int)strlen(file)), file);
+    if ((fd = open(name, O_RDONLY)) >= 0) {
+	want = readall(fd);
+	close(fd);
+	return want;
+    }
+    return ref != NULL ? refsection(ref, file) : NULL;
+}
+
+/*
+ * diff - print the lines that differ between want and got ("-" for
+ *    lines only in want, "+" for lines only in got), from a longest
+ *    common subsequence. Returns the number of differing lines.
+ */
+static int diff(char **want, int nw, char **got, int ng)
+{
+    int *lcs = (int *)calloc((size_t)(nw + 1) * (ng + 1), sizeof(int));
+    int i, j, ndiff = 0;
+
+    if (lcs == NULL)
+	unix_error("calloc error");
+#define LCS(i, j) lcs[(size_t)(i) * (ng + 1) + (j)]
+    for (i = nw - 1; i >= 0; i--)
+	for (j = ng - 1; j >= 0; j--)
+	    LCS(i, j) = strcmp(want[i], got[j]) == 0 ? LCS(i + 1, j + 1) + 1
+		: (LCS(i + 1, j) > LCS(i, j + 1) ? LCS(i + 1, j) : LCS(i, j + 1));
+    for (i = j = 0; i < nw || j < ng; ) {
+	if (i < nw && j < ng && strcmp(want[i], got[j]) == 0)
+	    i++, j++;
+	else if (j < ng && (i == nw || LCS(i, j + 1) >= LCS(i + 1, j))) {
+	    printf("  + %s\n", got[j++]);
+	    ndiff++;
+	}
+	else {
+	    printf("  - %s\n", want[i++]);
+	    ndiff++;
+	}
+    }
+#undef LCS
+    free(lcs);
+    return ndiff;
+}
+
+/* check - compare one trace's output with the reference; 1 if different */
+static int check(struct trace_t *t, const char *ref)
+{
+    char *got = readall(t->outfd), *want = expected(ref, t->file);
+    char **gotv, **wantv, *text = got;
+    const char *tty = NULL;
+    int ngot, nwant, i, bad;
+
+    if (want == NULL) {
+	printf("%s: no reference output\n", t->file);
+	free(got);
+	return 1;
+    }
+    if (strncmp(got, "tty=", 4) == 0) {
+	tty = got + 4;
+	text = got + strcspn(got, "\n");
+	*text++ = '\0';
+    }
+    gotv = splitlines(text, tty, &ngot);
+    wantv = splitlines(want, NULL, &nwant);
+
+    bad = (ngot != nwant);
+    for (i = 0; !bad && i < ngot; i++)
+	bad = strcmp(gotv[i], wantv[i]) != 0;
+    printf("%s: %s (%.0f ms)\n", t->file, bad ? "FAILED" : "ok", t->ns / 1e6);
+    if (bad)
+	diff(wantv, nwant, gotv, ngot);
+    free(gotv);
+    free(wantv);
+    free(got);
+    free(want);
+    return bad;
+}
+
+static void usage(const char *msg)
+{
+    if (msg != NULL)
+	fprintf(stderr, "%s\n", msg);
+    fprintf(stderr, "Usage: tdriver [-hv] [-s <shell>] [-a <args>] [-j <n>] "
+	    "[-r <ref>] <trace> ...\n");
+    fprintf(stderr, "Options:\n");
+    fprintf(stderr, "  -h            Print this message\n");
+    fprintf(stderr, "  -v            Be more verbose\n");
+    fprintf(stderr, "  -s <shell>    Shell program to test (default ./tsh)\n");
+    fprintf(stderr, "  -a <args>     Shell arguments (default -p)\n");
+    fprintf(stderr, "  -j <n>        Run at most <n> traces at once\n");
+    fprintf(stderr, "  -r <ref>      Compare with reference output <ref>\n");
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    const char *args = "-p", *reffile = NULL;
+    struct trace_t *traces;
+    int c, i, n, next, running, jobs = 0, failed = 0, fd;
+    char *arg, *ref = NULL;
+    long long t0 = now_ns();
+    pid_t pid;
+
+    while ((c = getopt(argc, argv, "hvs:a:j:r:")) != EOF) {
+	switch (c) {
+	case 'v':
+	    verbose = 1;
+	    break;
+	case 's':
+	    shell = optarg;
+	    break;
+	case 'a':
+	    args = optarg;
+	    break;
+	case 'j':
+	    jobs = atoi(optarg);
+	    break;
+	case 'r':
+	    reffile = optarg;
+	    break;
+	default:
+	    usage(NULL);
+	}
+    }
+    if (optind == argc)
+	usage("Missing trace file");
+    if (access(shell, X_OK) < 0) {
+	fprintf(stderr, "tdriver: ERROR: %s is not executable\n", shell);
+	exit(1);
+    }
+    if (reffile != NULL) {
+	if ((fd = open(reffile, O_RDONLY)) < 0) {
+	    fprintf(stderr, "tdriver: ERROR: %s: %s\n", reffile, strerror(errno));
+	    exit(1);
+	}
+	ref = readall(fd);
+	close(fd);
+    }
+
+    /* shell argv: the program, then <args> split on blanks */
+    shellargv[0] = (char *)shell;
+    i = 1;
+    for (arg = strtok(strdup(args), " \t"); arg != NULL && i < MAXSARGS - 1;
+	 arg = strtok(NULL, " \t"))
+	shellargv[i++] = arg;
+    shellargv[i] = NULL;
+
+    n = argc - optind;
+    if (jobs < 1 || jobs > n)
+	jobs = n;
+    if ((traces = (struct trace_t *)calloc(n, sizeof(struct trace_t))) == NULL)
+	unix_error("calloc error");
+    signal(SIGPIPE, SIG_IGN);
+    fflush(stdout);
+
+    /* keep <jobs> traces running until all have been started */
+    for (next = running = 0; next < n || running > 0; ) {
+	while (next < n && running < jobs) {
+	    struct trace_t *t = &traces[next];
+
+	    t->file = argv[optind + next++];
+	    if ((t->outfd = memfd_create(t->file, MFD_CLOEXEC)) < 0)
+		unix_error("memfd_create error");
+	    t->start = now_ns();
+	    if ((t->runner = fork()) < 0)
+		unix_error("fork error");
+	    if (t->runner == 0) {
+		dup2(t->outfd, 1);
+		exit(run_trace(t->file));
+	    }
+	    running++;
+	}
+	if ((pid = wait(NULL)) < 0) {
+	    if (errno == EINTR)
+		continue;
+	    unix_error("wait error");
+	}
+	for (i = 0; i < next; i++)
+	    if (traces[i].runner == pid) {
+		traces[i].runner = 0;
+		traces[i].ns = now_ns() - traces[i].start;
+		running--;
+	    }
+    }
+
+    for (i = 0; i < n; i++) {
+	if (ref != NULL)
+	    failed += check(&traces[i], ref);
+	else {
+	    char *out = readall(traces[i].outfd);
+
+	    printf("%s -t %s -s %s -a \"%s\"\n", argv[0], traces[i].file, shell, args);
+	    if (strncmp(out, "tty=", 4) == 0)
+		fputs(strchr(out, '\n') + 1, stdout);
+	    else
+		fputs(out, stdout);
+	    free(out);
+	}
+	close(traces[i].outfd);
+    }
+    if (ref != NULL)
+	printf("%d of %d traces passed in %.0f ms\n",
+	       n - failed, n, (now_ns() - t0) / 1e6);
+    exit(failed);
+}
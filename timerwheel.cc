@@ -0,0 +1,214 @@
+#include "timerwheel.h"
+#include "evloop.h"
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/timerfd.h>
+
+/****************************
+ * Hierarchical timing wheel
+ ****************************/
+
+#define TW_LEVELS   4
+#define TW_BITS     6
+#define TW_SLOTS    (1 << TW_BITS)
+#define TW_MASK     (TW_SLOTS - 1)
+#define TW_SPAN(l)  (1ULL << (TW_BITS * (l)))    /* ticks per slot at level l */
+
+static struct wtimer_t *wheel[TW_LEVELS][TW_SLOTS];
+static unsigned long long busy[TW_LEVELS];     /* bit s: slot s non-empty */
+static unsigned long long now;                 /* last tick run */
+static unsigned long long armedfor;            /* tick the timerfd is set for, 0: none */
+static long long base;                         /* CLOCK_MONOTONIC ms of tick 0 */
+static int tfd = -1;
+
+/* clockms - CLOCK_MONOTONIC in ms */
+static long long clockms(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* ticknow - The tick it is by the clock (never before the wheel's) */
+static unsigned long long ticknow(void)
+{
+    long long t = clockms() - base;
+
+    return (unsigned long long)t > now ? (unsigned long long)t : now;
+}
+
+/* insert - Put t in the slot for its expiry, relative to now: the
+ *    lowest level whose span reaches it */
+static void insert(struct wtimer_t *t)
+{
+    unsigned long long delta = t->expires - now, at = t->expires;
+    struct wtimer_t **slot;
+    int l, s;
+
+    for (l = 0; l < TW_LEVELS - 1 && delta >= TW_SPAN(l + 1); l++)
+	;
+    if (delta >= TW_SPAN(TW_LEVELS))	/* too far: wait in the last slot */
+	at = now + TW_SPAN(TW_LEVELS) - 1;
+    s = (at >> (TW_BITS * l)) & TW_MASK;
+    slot = &wheel[l][s];
+    if ((t->next = *slot) != NULL)
+	t->next->pprev = &t->next;
+    t->pprev = slot;
+    *slot = t;
+    busy[l] |= 1ULL << s;
+}
+
+/* detach - Take t out of its slot. Only the head of a slot has pprev
+ *    pointing into the wheel, and only then can the slot become empty. */
+static void detach(struct wtimer_t *t)
+{
+    struct wtimer_t **slot = t->pprev;
+    long i;
+
+    if ((*slot = t->next) != NULL)
+	t->next->pprev = slot;
+    t->pprev = NULL;
+    i = slot - &wheel[0][0];
+    if (*slot == NULL && i >= 0 && i < TW_LEVELS * TW_SLOTS)
+	busy[i / TW_SLOTS] &= ~(1ULL << (i % TW_SLOTS));
+}
+
+/* cascade - Move level l's current slot down to the levels below */
+static void cascade(int l)
+{
+    int s = (now >> (TW_BITS * l)) & TW_MASK;
+    struct wtimer_t *t = wheel[l][s], *next;
+
+    wheel[l][s] = NULL;
+    busy[l] &= ~(1ULL << s);
+    for (; t != NULL; t = next) {
+	next = t->next;
+	insert(t);
+    }
+}
+
+/* run - Advance the wheel to tick target, expiring what is due. Runs
+ *    of empty ticks are skipped: with levels below l empty nothing
+ *    can be due before the next multiple of level l's span. */
+static void run(unsigned long long target)
+{
+    unsigned long long next;
+    struct wtimer_t *t;
+    int l;
+
+    while (now < target) {
+	for (l = 0; l < TW_LEVELS && busy[l] == 0; l++)
+	    ;
+	if (l == TW_LEVELS)
+	    next = target;
+	else if (l == 0)
+	    next = now + 1;
+	else
+	    next = (now | (TW_SPAN(l) - 1)) + 1;
+	now = next < target ? next : target;
+
+	for (l = 1; l < TW_LEVELS && (now & (TW_SPAN(l) - 1)) == 0; l++)
+	    cascade(l);
+	while ((t = wheel[0][now & TW_MASK]) != NULL && t->expires <= now) {
+	    detach(t);
+	    t->fn(t, t->arg);	/* may add or cancel timers */
+	}
+    }
+}
+
+/* nextdue - The first tick after now at which something may be due:
+ *    the next level 0 timer or the next carry from the lowest busy
+ *    higher level, whichever comes first; 0 if none */
+static unsigned long long nextdue(void)
+{
+    unsigned long long bits, due = 0, carry;
+    int l, r;
+
+    if ((bits = busy[0]) != 0) {
+	r = (now + 1) & TW_MASK;		/* rotate so bit 0 is tick now+1 */
+	bits = (bits >> r) | (r ? bits << (TW_SLOTS - r) : 0);
+	due = now + 1 + __builtin_ctzll(bits);
+    }
+    for (l = 1; l < TW_LEVELS; l++)
+	if (busy[l] != 0) {
+	    carry = (now | (TW_SPAN(l) - 1)) + 1;
+	    if (due == 0 || carry < due)
+		due = carry;
+	    break;
+	}
+    return due;
+}
+
+/* arm - Set the timerfd for the next tick that needs a look */
+static void arm(void)
+{
+    struct itimerspec its;
+    unsigned long long due = nextdue();
+    long long at;
+
+    if (due == armedfor)
+	return;
+    memset(&its, 0, sizeof(its));
+    if (due != 0) {
+	at = base + (long long)due;
+	its.it_value.tv_sec = at / 1000;
+	its.it_value.tv_nsec = (at % 1000) * 1000000;
+    }
+    timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL);
+    armedfor = due;
+}
+
+/* timer_event - The timerfd fired: catch the wheel up with the clock */
+static void timer_event(int fd, unsigned events, void *arg)
+{
+    unsigned long long n;
+
+    if (read(fd, &n, sizeof(n)) < 0)
+	n = 0;			/* EAGAIN: look anyway, it is cheap */
+    armedfor = 0;
+    run(ticknow());
+    arm();
+}
+
+int tw_add(struct wtimer_t *t, long long ms, wtimerfn_t *fn, void *arg)
+{
+    if (tfd < 0) {
+	if ((tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) < 0)
+	    return -1;
+	if (ev_add(tfd, EPOLLIN, timer_event, NULL) < 0) {
+	    close(tfd);
+	    tfd = -1;
+	    return -1;
+	}
+	base = clockms();
+    }
+    if (ms < 1)
+	ms = 1;
+    if ((busy[0] | busy[1] | busy[2] | busy[3]) == 0)
+	now = ticknow();	/* idle wheel: nothing to run on the way */
+    t->expires = ticknow() + ms;
+    t->fn = fn;
+    t->arg = arg;
+    insert(t);
+    arm();
+    return 0;
+}
+
+void tw_del(struct wtimer_t *t)
+{
+    if (t->pprev != NULL)
+	detach(t);
+}
+
+long long tw_left(const struct wtimer_t *t)
+{
+    unsigned long long tick;
+
+    if (t->pprev == NULL)
+	return -1;
+    tick = ticknow();
+    return t->expires > tick ? (long long)(t->expires - tick) : 0;
+}
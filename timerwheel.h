@@ -0,0 +1,43 @@
+//-*-c++-*-
+#ifndef _timerwheel_h_
+#define _timerwheel_h_
+
+/*
+ * Timers on a hierarchical timing wheel: 4 levels of 64 slots with a
+ * 1 ms tick, covering 64^4 ms (4.6 hours) before a timer has to be
+ * carried over; longer ones simply wait in the top level. Adding,
+ * cancelling and expiring a timer are O(1) whatever the number of
+ * timers, and a timer is a struct the caller embeds, so there is no
+ * allocation either.
+ *
+ * One timerfd in the event loop (evloop.h) drives the wheel. It is
+ * armed for the next slot holding a timer, found from a per-level
+ * bitmap of non-empty slots, so the shell sleeps until a timer can
+ * actually be due rather than waking every tick.
+ */
+struct wtimer_t;
+typedef void wtimerfn_t(struct wtimer_t *t, void *arg);
+
+struct wtimer_t {
+    struct wtimer_t *next, **pprev;  /* slot list; pprev NULL if not armed */
+    unsigned long long expires;      /* tick (ms) it is due */
+    wtimerfn_t *fn;
+    void *arg;
+};
+
+/* tw_add - Call fn(t, arg) from the event loop in ms milliseconds.
+ *    t must not be armed already. Returns -1 if there is no timerfd. */
+int tw_add(struct wtimer_t *t, long long ms, wtimerfn_t *fn, void *arg);
+
+/* tw_del - Disarm t if it is armed */
+void tw_del(struct wtimer_t *t);
+
+/* tw_left - Milliseconds until t is due (0 if overdue), -1 if unarmed */
+long long tw_left(const struct wtimer_t *t);
+
+static inline int tw_armed(const struct wtimer_t *t)
+{
+    return t->pprev != 0;
+}
+
+#endif
@@ -0,0 +1,297 @@
+#include "tokenize.h"
+#include <stdlib.h>
+#include <string.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/****************************
+ * Command line tokenizer
+ ****************************/
+
+static const char *opname[] = {
+    NULL, "|", "&", ";", "<", ">", ">>", "&&", "||", "(", ")"
+};
+
+/* "0<" ... "2>>": redirections of a given descriptor */
+static const char *fdopname[3][3] = {
+    { "0<", "0>", "0>>" }, { "1<", "1>", "1>>" }, { "2<", "2>", "2>>" }
+};
+
+/* endsword - Is c an operator character that ends a word? */
+static inline int endsword(char c)
+{
+    return c == '|' || c == '&' || c == ';' || c == '(' || c == ')';
+}
+
+/*
+ * scanword - First byte at or after p that is a blank (any byte up to
+ *    ' ', which includes the NUL at end), a quote, a backslash or an
+ *    operator that ends a word. With SSE2 this looks at 16 bytes per
+ *    step; the last few bytes, and everything without SSE2, go one at
+ *    a time up to the NUL at end.
+ */
+static char *scanword(char *p, const char *end)
+{
+#ifdef __SSE2__
+    const __m128i blank = _mm_set1_epi8(' ');
+    const __m128i amp = _mm_set1_epi8('&'), three = _mm_set1_epi8(3);
+    const __m128i dq = _mm_set1_epi8('"'), bs = _mm_set1_epi8('\\');
+    const __m128i bar = _mm_set1_epi8('|'), semi = _mm_set1_epi8(';');
+    __m128i v, m, x;
+    int bits;
+
+    while (end - p >= 16) {
+	v = _mm_loadu_si128((const __m128i *)p);
+	m = _mm_cmpeq_epi8(_mm_min_epu8(v, blank), v);	/* v <= ' ' */
+	x = _mm_sub_epi8(v, amp);			/* & ' ( ) in one go */
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(_mm_min_epu8(x, three), x));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, dq));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, bs));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, bar));
+	m = _mm_or_si128(m, _mm_cmpeq_epi8(v, semi));
+	if ((bits = _mm_movemask_epi8(m)) != 0)
+	    return p + __builtin_ctz(bits);
+	p += 16;
+    }
+#endif
+    while ((unsigned char)*p > ' ' && *p != '\'' && *p != '"' && *p != '\\' &&
+	   !endsword(*p))
+	p++;
+    return p;
+}
+
+/* scandq - First '"' or '\\' at or after p, or end */
+static char *scandq(char *p, const char *end)
+{
+#ifdef __SSE2__
+    const __m128i dq = _mm_set1_epi8('"'), bs = _mm_set1_epi8('\\');
+    __m128i v;
+    int bits;
+
+    while (end - p >= 16) {
+	v = _mm_loadu_si128((const __m128i *)p);
+	bits = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(v, dq),
+					      _mm_cmpeq_epi8(v, bs)));
+	if (bits != 0)
+	    return p + __builtin_ctz(bits);
+	p += 16;
+    }
+#endif
+    while (p < end && *p != '"' && *p != '\\')
+	p++;
+    return p;
+}
+
+/* opkind - The operator starting at p, or TOK_WORD */
+static int opkind(const char *p)
+{
+    switch (*p) {
+    case '|': return p[1] == '|' ? TOK_OR : TOK_PIPE;
+    case '&': return p[1] == '&' ? TOK_AND : TOK_BG;
+    case ';': return TOK_SEMI;
+    case '<': return TOK_IN;
+    case '>': return p[1] == '>' ? TOK_APPEND : TOK_OUT;
+    case '(': return TOK_LPAREN;
+    case ')': return TOK_RPAREN;
+    default:  return TOK_WORD;
+    }
+}
+
+/*
+ * fdop - The redirection starting at p if it is one: TOK_DUP for a
+ *    whole word [N]>&M, or TOK_IN/OUT/APPEND for N< N> N>> with the
+ *    text in *text and the length in *len. TOK_WORD if it is neither.
+ */
+static int fdop(const char *p, const char **text, size_t *len)
+{
+    const char *q = p;
+    int fd, kind;
+
+    if (*q >= '0' && *q <= '2')
+	q++;
+    if (q[0] == '>' && q[1] == '&' && q[2] >= '0' && q[2] <= '9' &&
+	(unsigned char)q[3] <= ' ') {
+	*len = q + 3 - p;
+	return TOK_DUP;
+    }
+    if (q == p || (*q != '<' && *q != '>'))
+	return TOK_WORD;	/* a plain > is opkind's */
+    fd = *p - '0';
+    kind = opkind(q);
+    *text = fdopname[fd][kind == TOK_IN ? 0 : kind == TOK_OUT ? 1 : 2];
+    *len = strlen(*text);
+    return kind;
+}
+
+/* escapable - Can an unquoted backslash escape c? */
+static int escapable(char c)
+{
+    return c == ' ' || c == '\t' || c == '\'' || c == '"' || c == '\\' ||
+	(c != '\0' && opkind(&c) != TOK_WORD);
+}
+
+/* growtoks - Double the token arrays */
+static int growtoks(struct toklist_t *tl)
+{
+    int cap = tl->cap ? 2 * tl->cap : 64;
+    char **argv;
+    unsigned char *k;
+    int *pos;
+
+    if ((argv = (char **)realloc(tl->argv, cap * sizeof(char *))) == NULL)
+	return 0;
+    tl->argv = argv;
+    if ((k = (unsigned char *)realloc(tl->kind, cap)) == NULL)
+	return 0;
+    tl->kind = k;
+    if ((pos = (int *)realloc(tl->pos, cap * sizeof(int))) == NULL)
+	return 0;
+    tl->pos = pos;
+    tl->cap = cap;
+    return 1;
+}
+
+/* addtok - Append a token that starts at offset pos */
+static inline int addtok(struct toklist_t *tl, char *text, int kind, int pos)
+{
+    if (tl->ntoks + 1 >= tl->cap && !growtoks(tl))
+	return 0;
+    tl->argv[tl->ntoks] = text;
+    tl->pos[tl->ntoks] = pos;
+    tl->kind[tl->ntoks++] = kind;
+    return 1;
+}
+
+/*
+ * tokenize - Split buf[0..len) into words and operators. Each word is
+ *    unquoted by sliding its bytes down over the quotes and escapes;
+ *    a word with none is not moved at all, only NUL terminated where
+ *    the blank after it was.
+ */
+int tokenize(char *buf, size_t len, struct toklist_t *tl)
+{
+    char *r = buf, *w, *s, *q, *end = buf + len;
+    const char *optext;
+    size_t oplen;
+    int kind;
+
+    *end = '\0';
+    tl->ntoks = 0;
+
+    for (;;) {
+	while (r < end && (unsigned char)*r <= ' ')
+	    r++;
+	if (r >= end)
+	    break;
+
+	if ((*r == '>' || (*r >= '0' && *r <= '2')) &&
+	    (kind = fdop(r, &optext, &oplen)) != TOK_WORD) {
+	    if (kind == TOK_DUP) {	/* the word itself, "2>&1" */
+		optext = r;
+		r[oplen] = '\0';
+		oplen++;
+	    }
+	    r += oplen;
+	    if (!addtok(tl, (char *)optext, kind, r - oplen - buf))
+		return -1;
+	    continue;
+	}
+	if ((kind = opkind(r)) != TOK_WORD) {
+	    if (!addtok(tl, (char *)opname[kind], kind, r - buf))
+		return -1;
+	    r += strlen(opname[kind]);
+	    continue;
+	}
+
+	w = r;
+	if (!addtok(tl, w, TOK_WORD, r - buf))
+	    return -1;
+	for (;;) {
+	    s = scanword(r, end);
+	    if (w != r)
+		memmove(w, r, s - r);
+	    w += s - r;
+	    r = s;
+	    if (r >= end || (unsigned char)*r <= ' ' || endsword(*r))
+		break;
+
+	    if (*r == '\'') {		/* '...': everything up to the next ' */
+		if ((q = (char *)memchr(r + 1, '\'', end - r - 1)) == NULL)
+		    return -1;
+		memmove(w, r + 1, q - r - 1);
+		w += q - r - 1;
+		r = q + 1;
+	    }
+	    else if (*r == '"') {	/* "...": \ escapes " \ $ ` only */
+		for (r++; ; ) {
+		    s = scandq(r, end);
+		    memmove(w, r, s - r);
+		    w += s - r;
+		    r = s;
+		    if (r >= end)
+			return -1;
+		    if (*r == '"') {
+			r++;
+			break;
+		    }
+		    if (r[1] == '"' || r[1] == '\\' || r[1] == '$' || r[1] == '`') {
+			*w++ = r[1];
+			r += 2;
+		    }
+		    else
+			*w++ = *r++;
+		}
+	    }
+	    else if (r[1] == '\n')	/* line continuation */
+		r += 2;
+	    else if (escapable(r[1])) {
+		*w++ = r[1];
+		r += 2;
+	    }
+	    else
+		*w++ = *r++;		/* \0NN and friends stay as typed */
+	}
+	if (r < end && endsword(*r)) {	/* "a;b": the operator ends the word */
+	    kind = opkind(r);		/* before the NUL may land on it */
+	    *w = '\0';
+	    if (!addtok(tl, (char *)opname[kind], kind, r - buf))
+		return -1;
+	    r += strlen(opname[kind]);
+	    continue;
+	}
+	*w = '\0';
+	if (r < end)
+	    r++;
+    }
+    if (!addtok(tl, NULL, TOK_WORD, len))	/* the NULL after the last */
+	return -1;
+    return --tl->ntoks;
+}
+
+/* tokenize_line - tokenize a copy of line kept in tl->arena */
+int tokenize_line(const char *line, size_t len, struct toklist_t *tl)
+{
+    char *arena;
+    size_t cap;
+
+    if (len + 1 > tl->arenacap) {
+	for (cap = tl->arenacap ? tl->arenacap : 1024; cap < len + 1; cap *= 2)
+	    ;
+	if ((arena = (char *)realloc(tl->arena, cap)) == NULL)
+	    return -1;
+	tl->arena = arena;
+	tl->arenacap = cap;
+    }
+    memcpy(tl->arena, line, len);
+    return tokenize(tl->arena, len, tl);
+}
+
+void tokfree(struct toklist_t *tl)
+{
+    free(tl->argv);
+    free(tl->kind);
+    free(tl->pos);
+    free(tl->arena);
+    memset(tl, 0, sizeof(*tl));
+}
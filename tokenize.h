@@ -0,0 +1,57 @@
+//-*-c++-*-
+#ifndef _tokenize_h_
+#define _tokenize_h_
+
+#include <stddef.h>
+
+/*
+ * Command line tokenizer. Words are unquoted in place and argv points
+ * straight into the buffer, so there is no copy of the line and no
+ * limit on its length or on the number of words.
+ *
+ * Quoting: '...' is taken literally; inside "..." a backslash escapes
+ * only " \ $ and `; outside quotes it escapes a blank, a quote, a
+ * backslash or an operator character and is otherwise kept, so the
+ * traces' "echo -e ... \046" still reaches echo intact.
+ *
+ * Operators start a new token wherever they are, and | & ; ( and )
+ * also end the word before them ("a;b" is three tokens); < and > are
+ * operators only at the start of a word, so the traces' "tsh>" stays
+ * one. An operator's text is a static string. A redirection may name descriptor 0, 1 or 2 first ("2>", "2>>", and
+ * so on; the text then starts with the digit), and a word of the form
+ * [N]>&M is a TOK_DUP.
+ */
+#define TOK_WORD    0
+#define TOK_PIPE    1   /* |  */
+#define TOK_BG      2   /* &  */
+#define TOK_SEMI    3   /* ;  */
+#define TOK_IN      4   /* <  */
+#define TOK_OUT     5   /* >  */
+#define TOK_APPEND  6   /* >> */
+#define TOK_AND     7   /* && */
+#define TOK_OR      8   /* || */
+#define TOK_LPAREN  9   /* (  */
+#define TOK_RPAREN 10   /* )  */
+#define TOK_DUP    11   /* [N]>&M, e.g. 2>&1 */
+
+struct toklist_t {
+    char **argv;          /* ntoks words/operators, NULL terminated */
+    unsigned char *kind;  /* TOK_* of each */
+    int *pos;             /* offset in the line where each starts */
+    int ntoks, cap;
+    char *arena;          /* copy of the line for tokenize_line */
+    size_t arenacap;
+};
+
+/* Tokenize buf[0..len) in place (buf[len] must be writable).
+ * Returns the number of tokens, or -1 on an unterminated quote
+ * (or if memory runs out). */
+int tokenize(char *buf, size_t len, struct toklist_t *tl);
+
+/* Same, over a copy of line kept in tl (for callers that still need
+ * the line afterwards). The tokens are valid until the next call. */
+int tokenize_line(const char *line, size_t len, struct toklist_t *tl);
+
+void tokfree(struct toklist_t *tl);
+
+#endif
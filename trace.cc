@@ -0,0 +1,214 @@
+#include "trace.h"
+#include "jobs.h"
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/wait.h>
+
+/****************************
+ * Event trace
+ ****************************/
+
+struct trace_ev {
+    long long ns;
+    long long arg;
+    int type;
+    pid_t pid;
+    int jid;
+};
+
+int trace_on = 0;
+struct hist_t hist_spawn, hist_fg;
+
+static struct trace_ev *ring;
+static size_t ringcap;              /* a power of two */
+static unsigned long long head;     /* events recorded so far */
+static unsigned long long ntype[TR_FGDONE + 1];
+
+static const char *evname[] = {
+    "parse", "spawn", "exec", "state", "signal", "kill", "reap", "fgdone"
+};
+static const char *statename[] = { "UNDEF", "FG", "BG", "ST", "QU", "WA" };
+
+void trace_init(size_t nevents)
+{
+    for (ringcap = 256; ringcap < nevents; ringcap *= 2)
+	;
+    if ((ring = (struct trace_ev *)calloc(ringcap, sizeof(*ring))) == NULL)
+	return;			/* no tracing, then */
+    trace_reset();
+    trace_on = 1;
+}
+
+long long trace_now(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void trace_add(int type, pid_t pid, int jid, long long arg)
+{
+    struct trace_ev *ev = &ring[head++ & (ringcap - 1)];
+
+    ev->ns = trace_now();
+    ev->type = type;
+    ev->pid = pid;
+    ev->jid = jid;
+    ev->arg = arg;
+    ntype[type]++;
+}
+
+/* sigjson - "INT" for SIGINT, or the number if it has no name */
+static void sigjson(FILE *fp, const char *key, int sig)
+{
+    const char *name = sigabbrev_np(sig);
+
+    if (name != NULL)
+	fprintf(fp, ",\"%s\":\"%s\"", key, name);
+    else
+	fprintf(fp, ",\"%s\":%d", key, sig);
+}
+
+size_t trace_dump(FILE *fp)
+{
+    unsigned long long i = head > ringcap ? head - ringcap : 0;
+    struct trace_ev *ev;
+    size_t n = 0;
+
+    for (; i < head; i++, n++) {
+	ev = &ring[i & (ringcap - 1)];
+	fprintf(fp, "{\"t\":%lld,\"ev\":\"%s\"", ev->ns, evname[ev->type]);
+	if (ev->pid != 0)
+	    fprintf(fp, ",\"pid\":%d", (int)ev->pid);
+	if (ev->jid != 0)
+	    fprintf(fp, ",\"jid\":%d", ev->jid);
+	switch (ev->type) {
+	case TR_PARSE: case TR_EXEC: case TR_FGDONE:
+	    fprintf(fp, ",\"ns\":%lld", ev->arg);
+	    break;
+	case TR_STATE:
+	    fprintf(fp, ",\"state\":\"%s\"", statename[ev->arg]);
+	    break;
+	case TR_SIGNAL: case TR_KILL:
+	    sigjson(fp, "sig", (int)ev->arg);
+	    break;
+	case TR_REAP:
+	    if (WIFSIGNALED((int)ev->arg))
+		sigjson(fp, "termsig", WTERMSIG((int)ev->arg));
+	    else
+		fprintf(fp, ",\"exit\":%d", WEXITSTATUS((int)ev->arg));
+	    break;
+	}
+	fputs("}\n", fp);
+    }
+    fflush(fp);
+    return n;
+}
+
+void trace_reset(void)
+{
+    head = 0;
+    memset(ntype, 0, sizeof(ntype));
+    memset(&hist_spawn, 0, sizeof(hist_spawn));
+    memset(&hist_fg, 0, sizeof(hist_fg));
+}
+
+/* bucket - Histogram bucket of v: v itself below HIST_SUB, then
+ *    HIST_SUB buckets per power of two picked by the bits below the top one */
+static inline int bucket(unsigned long long v)
+{
+    int e;
+
+    if (v < HIST_SUB)
+	return (int)v;
+    e = 63 - __builtin_clzll(v);
+    return (e - HIST_SUBBITS + 1) * HIST_SUB +
+	(int)((v >> (e - HIST_SUBBITS)) - HIST_SUB);
+}
+
+/* buckettop - The largest value that falls in bucket i */
+static long long buckettop(int i)
+{
+    int k = i / HIST_SUB;
+
+    if (k == 0)
+	return i;
+    return ((long long)(i % HIST_SUB + HIST_SUB + 1) << (k - 1)) - 1;
+}
+
+void hist_add(struct hist_t *h, long long v)
+{
+    if (v < 0)
+	v = 0;
+    h->count[bucket(v)]++;
+    if (h->n == 0 || v < h->min)
+	h->min = v;
+    if (v > h->max)
+	h->max = v;
+    h->n++;
+    h->sum += v;
+}
+
+long long hist_percentile(const struct hist_t *h, double p)
+{
+    unsigned long long want = (unsigned long long)(p * h->n + 0.999999), seen = 0;
+    int i;
+
+    if (h->n == 0)
+	return 0;
+    if (want < 1)
+	want = 1;
+    for (i = 0; i < HIST_BUCKETS; i++)
+	if ((seen += h->count[i]) >= want)
+	    break;
+    return buckettop(i) < h->max ? buckettop(i) : h->max;
+}
+
+/* fmtns - ns in the unit that suits it */
+static const char *fmtns(char *buf, size_t size, double ns)
+{
+    if (ns < 1e3)
+	snprintf(buf, size, "%.0fns", ns);
+    else if (ns < 1e6)
+	snprintf(buf, size, "%.1fus", ns / 1e3);
+    else if (ns < 1e9)
+	snprintf(buf, size, "%.2fms", ns / 1e6);
+    else
+	snprintf(buf, size, "%.3fs", ns / 1e9);
+    return buf;
+}
+
+static void hist_print(const struct hist_t *h, const char *name, FILE *fp)
+{
+    static const double pct[] = { 0.5, 0.9, 0.99, 0.999 };
+    static const char *pctname[] = { "p50", "p90", "p99", "p99.9" };
+    char buf[32];
+    int i;
+
+    fprintf(fp, "%-7s n=%llu", name, h->n);
+    if (h->n > 0) {
+	fprintf(fp, " min=%s", fmtns(buf, sizeof(buf), h->min));
+	for (i = 0; i < 4; i++)
+	    fprintf(fp, " %s=%s", pctname[i],
+		    fmtns(buf, sizeof(buf), hist_percentile(h, pct[i])));
+	fprintf(fp, " max=%s", fmtns(buf, sizeof(buf), h->max));
+	fprintf(fp, " mean=%s", fmtns(buf, sizeof(buf), h->sum / h->n));
+    }
+    fputc('\n', fp);
+}
+
+void trace_print(FILE *fp)
+{
+    int i;
+
+    fprintf(fp, "events  %llu (ring of %zu, %llu overwritten):", head, ringcap,
+	    head > ringcap ? head - ringcap : 0);
+    for (i = 0; i <= TR_FGDONE; i++)
+	fprintf(fp, " %s=%llu", evname[i], ntype[i]);
+    fputc('\n', fp);
+    hist_print(&hist_spawn, "spawn", fp);
+    hist_print(&hist_fg, "fg", fp);
+}
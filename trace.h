@@ -0,0 +1,79 @@
+//-*-c++-*-
+#ifndef _trace_h_
+#define _trace_h_
+
+#include <stdio.h>
+#include <sys/types.h>
+
+/*
+ * Event trace (tsh -v). Events are stamped with CLOCK_MONOTONIC in
+ * nanoseconds and kept in a fixed ring, the oldest overwritten once
+ * it is full, so tracing costs a clock read and a 32-byte store per
+ * event and no allocation. trace_dump writes them out as JSON lines.
+ *
+ * Two latency histograms are kept as well: spawn (from starting a
+ * process to launch returning, which with posix_spawn is after the
+ * exec) and fg (from a foreground command line being parsed to the
+ * job leaving the foreground).
+ */
+#define TR_PARSE   0   /* a command line parsed; arg = ns taken */
+#define TR_SPAWN   1   /* a process is being started */
+#define TR_EXEC    2   /* ... and is running its program; arg = ns */
+#define TR_STATE   3   /* a job changed state; arg = FG, BG, ST, QU, WA */
+#define TR_SIGNAL  4   /* the shell got a signal; pid = sender */
+#define TR_KILL    5   /* the shell sent a job a signal; arg = sig */
+#define TR_REAP    6   /* a process was reaped; arg = wait status */
+#define TR_FGDONE  7   /* a foreground job is done or stopped; arg = ns */
+
+/*
+ * An HDR-style histogram: exact below 16, then 16 buckets for each
+ * power of two, so any value is off by at most 1/16 (6%) whatever
+ * its size, in a fixed 8 KB.
+ */
+#define HIST_SUBBITS 4
+#define HIST_SUB (1 << HIST_SUBBITS)
+#define HIST_BUCKETS ((64 - HIST_SUBBITS + 1) * HIST_SUB)
+
+struct hist_t {
+    unsigned long long count[HIST_BUCKETS];
+    unsigned long long n;
+    long long min, max;
+    double sum;
+};
+
+extern int trace_on;               // set by trace_init
+extern struct hist_t hist_spawn;   // ns from spawn to exec
+extern struct hist_t hist_fg;      // ns from parse to fg job done
+
+/* trace_init - Start tracing into a ring of nevents events */
+void trace_init(size_t nevents);
+
+/* trace_now - CLOCK_MONOTONIC in ns */
+long long trace_now(void);
+
+/* trace_add - Record an event now (use trace(), which checks trace_on) */
+void trace_add(int type, pid_t pid, int jid, long long arg);
+
+static inline void trace(int type, pid_t pid, int jid, long long arg)
+{
+    if (trace_on)
+	trace_add(type, pid, jid, arg);
+}
+
+/* trace_dump - The events still in the ring, oldest first, one JSON
+ *    object per line; returns how many were written */
+size_t trace_dump(FILE *fp);
+
+/* trace_reset - Forget the events and empty the histograms */
+void trace_reset(void);
+
+/* trace_print - Event counts and both histograms, for the stats builtin */
+void trace_print(FILE *fp);
+
+void hist_add(struct hist_t *h, long long v);
+
+/* hist_percentile - The value below which a fraction p of the values
+ *    fall (the top of its bucket, but no more than the largest seen) */
+long long hist_percentile(const struct hist_t *h, double p);
+
+#endif
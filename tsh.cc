@@ -15,18 +15,118 @@ using namespace std;
 #include <sys/types.h>
 #include <sys/wait.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/signalfd.h>
+#include <stdint.h>
 #include <string>
 
 #include "globals.h"
 #include "jobs.h"
 #include "helper-routines.h"
+#include "launch.h"
+#include "pathcache.h"
+#include "fastio.h"
+#include "evloop.h"
+#include "tokenize.h"
+#include "utils.h"
+#include "procfd.h"
+#include "outring.h"
+#include "trace.h"
+#include "history.h"
 
 //
 // Needed global variable definitions
 //
 
+#ifndef TSH_NOMAIN
 static char prompt[] = "tsh> ";
+#endif
 int verbose = 0;
+sigset_t childmask;   // signal mask children start with
+struct jobstats_t fgstats;  // resource use of the last finished fg job
+pid_t fgstats_pid;          // ... and its PID
+static int fgsig;           // SIGINT/SIGTSTP that came with no fg job
+int lastexit = 0;           // exit status of the last foreground command
+static int fgintr;          // ... which was stopped or ctrl-c'ed: the rest
+                            // of its line is not run
+static int pidfd_ok = 1;    // children's exits come through pidfds
+static int shellredir;      // a builtin runs on redirected fds 0-2
+static int builtinin = -1;  // a B_INFILE builtin's "< file", or -1
+static int stdincmds;       // readcmd reads the commands from stdin
+int capture = 0;            // -o: bg jobs' output goes to a ring buffer
+int joblimit = 0;           // -j: most jobs running at once, 0: no limit
+static struct job_t *following;         // job whose output is being shown
+static unsigned long long followpos;    // ... up to here
+
+#define OUTRING (64 * 1024)  // bytes of output kept per captured job
+#define TRACE_EVENTS 16384   // events kept by tsh -v (trace.h)
+#define KILLGRACE 5000       // ms from a deadline's SIGTERM to its SIGKILL
+
+//
+// A running parallel builtin. Its jobs are ordinary background jobs;
+// childdone hands each one to pardone as it is reaped, which frees
+// its slot and adds up what it used.
+//
+struct partab_t {
+  pid_t *slots;           //leader of the job in each slot, 0 if free
+  int nslots, busy;
+  int done, failed;       //jobs finished, and those that did not exit 0
+  struct rusage ru;       //summed over the finished jobs
+};
+static struct partab_t *par;  //NULL unless parallel is running
+
+//
+// The graph of jobs made by the after builtin, with the jobs they run
+// after. A node outlives its job, which the job list tells dagnote
+// about as it goes; dagrun then starts or drops what waits on it.
+//
+#define DAG_WAIT 0        //its job is WA
+#define DAG_RUN 1         //its job is running or queued
+#define DAG_OK 2          //its job exited 0
+#define DAG_FAIL 3        //... did not, or never started
+#define DAG_SKIP 4        //its job was dropped: something it needed failed
+
+struct dagnode_t {
+  struct job_t *job;      //NULL once the job is gone
+  int jid;
+  char *text;             //its command line
+  int state;
+  int nwait;              //predecessors yet to succeed
+  int *succ, nsucc, succcap;
+  int via;                //the predecessor that let it start, or -1
+  int told;               //its successors have heard how it did
+  int ran;                //it had processes
+  struct timespec start, end;
+};
+struct dag_t {
+  struct dagnode_t *nodes;
+  int n, cap;
+  int live;               //nodes not yet done
+  int dirty;              //a node is done that dagrun has not seen
+};
+static struct dag_t *dag;  //NULL unless after has jobs in hand
+
+//
+// The builtin commands, looked up by builtin_lookup for builtin_cmd
+// and runcmd. A B_JOBARG builtin is one only when its first argument
+// is a %jobid; otherwise the name is the program's. A B_REDIR builtin
+// may run on the shell's own descriptors redirected ("jobs > file"):
+// it never runs the event loop, so no job is started, and nothing is
+// reported, while they are not the shell's. A B_INFILE builtin may
+// take a lone "< file", which it reads from builtinin while the
+// shell's descriptors (and its jobs') stay as they are.
+//
+#define B_JOBARG 1
+#define B_REDIR 2
+#define B_INFILE 4
+
+struct builtin_t {
+  const char *name;
+  void (*fn)(char **argv);
+  int flags;
+};
 
 //
 // You need to implement the functions eval, builtin_cmd, do_bgfg,
@@ -37,21 +137,146 @@ int verbose = 0;
 // function bodies below.
 // 
 
+//
+// A parsed pipeline, with the room needed to launch it. Each pipeline
+// of a compiled line has one (see compile) and startqueued another,
+// since queued jobs are started from the event loop, possibly while
+// eval is waiting for a foreground job.
+//
+struct cmd_t {
+  struct toklist_t toks;  //tokens of the line, kept for reuse
+  char **args;            //argument list, without a leading "time"
+  char ***stagev;         //argv of each pipeline stage
+  pid_t *pids;            //process id of each stage
+  struct redir_t *redirs; //redirections of every stage...
+  int *stageredir;        //... stage i's from stageredir[i] on
+  int stagecap;
+  int nstages, bg, timed;
+  long long timeout;      //"timeout DUR cmd": ms the job may run, or 0
+};
+
+//
+// A compiled command line: a tree of the ;, &, && and || lists, ( )
+// groups and repeat prefixes in it, over parsed pipelines. eval keeps
+// the last LINECACHE lines it saw, found by a hash of the line, so a
+// line run again is neither tokenized nor parsed again. Each line's
+// nodes and its pipelines' arrays are carved out of buffers sized by
+// its token count, and a cache slot's buffers are reused by the next
+// line that lands in it.
+//
+#define LINECACHE 64
+
+#define N_PIPE   0   // a pipeline: cmd, text
+#define N_SEQ    1   // left ; right, or left & right with left a bg pipeline
+#define N_AND    2   // left && right: right if left exits 0
+#define N_OR     3   // left || right: right if left does not
+#define N_REPEAT 4   // repeat count left
+#define N_TIME   5   // time left, for a group or repeat (else cmd.timed)
+
+struct node_t {
+  int type;
+  long count;                  //N_REPEAT: times to run left
+  struct node_t *left, *right;
+  struct cmd_t cmd;            //N_PIPE: the pipeline, parsed
+  int first, end;              //N_PIPE: its tokens
+  const char *text;            //N_PIPE: its part of the line, for jobs
+};
+
+struct line_t {
+  unsigned long long hash;     //of line; 0 if the slot holds nothing
+  char *line;                  //the line, ending in '\n'
+  size_t linecap;
+  struct toklist_t toks;
+  struct node_t *nodes;        //nodes[0..nnodes), the root last
+  int nnodes;
+  int cap;                     //room for this many tokens (+1) in...
+  char ***stagev;              //... the pipelines' arrays, each one
+  pid_t *pids;                 //    using those of its first token on
+  struct redir_t *redirs;
+  int *stageredir;
+  char *texts;                 //the pipelines' texts
+  size_t textcap;
+};
+
+char *readcmd(void);
 void eval(char *cmdline);
-int builtin_cmd(char **argv);
+struct node_t *compile(const char *cmdline);
+void runnode(struct node_t *n);
+void runcmd(struct cmd_t *c, const char *cmdline);
+static const struct builtin_t *builtin_lookup(char **argv);
+static void rusage_since(struct rusage *ru, const struct rusage *was);
+int parsecmd(const char *cmdline, struct cmd_t *c);
+int parseargs(struct cmd_t *c, char **argv, const unsigned char *kind, int ntoks,
+              int bg);
+struct job_t *runjob(struct cmd_t *c, const char *cmdline, struct job_t *job,
+                     int state);
+struct job_t *startqueued(struct job_t *job, int state);
+void admit(void);
+void batch_file(const char *file);
+void batch_run(char *buf, size_t len);
+int splitpipeline(char **argv, const unsigned char *kind, char ***stagev);
+int splitredirs(char **argv, const unsigned char *kind, char ***stagev,
+                int nstages, struct redir_t *redirs, int *stageredir);
+int redirect_shell(const struct redir_t *redirs, int nredirs, int *saved);
+void restore_shell(int *saved);
+pid_t launch_stage(char **argv, pid_t pgid, const struct childio_t *io,
+                   const sigset_t *childmask, int inpipe);
+int launch_pipeline(char ***stagev, int nstages, const struct redir_t *redirs,
+                    const int *stageredir, int outfd, const struct place_t *place,
+                    const sigset_t *childmask, pid_t *pids);
+int builtin_cmd(char **argv, int inshell);
+void do_quit(char **argv);
+void do_jobs(char **argv);
+void print_time(const struct jobstats_t *ts);
 void do_bgfg(char **argv);
+void do_hash(char **argv);
+void do_sleep(char **argv);
+void do_output(char **argv);
+void do_limit(char **argv);
+void do_parallel(char **argv);
+void do_stats(char **argv);
+void do_deadline(char **argv);
+void do_history(char **argv);
+void do_after(char **argv);
+static void afterfile(const char *file);
+static int dagadd(struct job_t *job);
+static void dagedge(int from, int to);
+void dagnote(struct job_t *job);
+static void jobgone(struct job_t *job);
+void do_affinity(char **argv);
+void do_nice(char **argv);
+static struct job_t *jobarg(char **argv);
+static void dagstart(int i);
+void dagrun(void);
+static void dagreport(void);
+static void daglist(void);
+void setdeadline(struct job_t *job, long long ms);
+void deadline_event(struct wtimer_t *t, void *arg);
+void pardone(struct job_t *job, int status);
+void output_event(int fd, unsigned events, void *arg);
+void releaseoutput(struct job_t *job);
 void waitfg(pid_t pid);
+void watchjob(struct job_t *job);
+void child_event(int fd, unsigned events, void *arg);
+void childstopped(pid_t pid, int sig);
+void childdone(pid_t pid, int status, const struct rusage *ru);
 
+void tsh_init(void);
+static void trace_atexit(void);
+void signal_event(int fd, unsigned events, void *arg);
 void sigchld_handler(int sig);
 void sigtstp_handler(int sig);
 void sigint_handler(int sig);
 
+#ifndef TSH_NOMAIN
 //
 // main - The shell's main routine 
 //
 int main(int argc, char **argv) 
 {
   int emit_prompt = 1; // emit prompt (default)
+  const char *script = NULL; // -f file
+  char *command = NULL;      // -c string
 
   //
   // Redirect stderr to stdout (so that driver will get all output
@@ -61,7 +286,7 @@ int main(int argc, char **argv)
 
   /* Parse the command line */
   char c;
-  while ((c = getopt(argc, argv, "hvp")) != EOF) {
+  while ((c = getopt(argc, argv, "hvpnozj:a:f:c:")) != EOF) {
     switch (c) {
     case 'h':             // print help message
       usage();
@@ -72,31 +297,65 @@ int main(int argc, char **argv)
     case 'p':             // don't print a prompt
       emit_prompt = 0;  // handy for automatic testing
       break;
+    case 'n':             // run echo, sleep, ... as the real programs
+      util_external = 1;
+      break;
+    case 'o':             // keep bg jobs' output for the output builtin
+      capture = 1;
+      break;
+    case 'z':             // start commands from a pre-forked zygote
+      launch_mode = LAUNCH_ZYGOTE;
+      break;
+    case 'j':             // run at most N jobs, queue the rest
+      joblimit = atoi(optarg);
+      break;
+    case 'a':             // pin bg jobs to CPUs: roundrobin, packed or none
+      if (place_setpolicy(optarg) < 0)
+        usage();
+      break;
+    case 'f':             // run the commands in a file, then exit
+      script = optarg;
+      break;
+    case 'c':             // run the commands in a string, then exit
+      command = optarg;
+      break;
     default:
       usage();
     }
   }
 
   //
-  // Install the signal handlers
+  // Set up signals, the event loop and the job list
   //
+  tsh_init();
 
   //
-  // These are the ones you will need to implement
+  // Batch mode: no prompt, no reading from stdin; the shell exits
+  // with the status of the last command, for scripts that check it
   //
-  Signal(SIGINT,  sigint_handler);   // ctrl-c
-  Signal(SIGTSTP, sigtstp_handler);  // ctrl-z
-  Signal(SIGCHLD, sigchld_handler);  // Terminated or stopped child
+  if (script != NULL || command != NULL) {
+    if (script != NULL)
+      batch_file(script);
+    else
+      batch_run(command, strlen(command));
+    fflush(stdout);
+    exit(lastexit);
+  }
 
   //
-  // This one provides a clean way to kill the shell
+  // Keep a history when someone is typing (or $TSH_HISTFILE says to)
   //
-  Signal(SIGQUIT, sigquit_handler); 
+  if (isatty(STDIN_FILENO) || getenv("TSH_HISTFILE") != NULL) {
+    const char *file = getenv("TSH_HISTFILE");
+    std::string path;
 
-  //
-  // Initialize the job list
-  //
-  initjobs(jobs);
+    if (file == NULL) {
+      path = getenv("HOME") != NULL ? getenv("HOME") : ".";
+      path += "/.tsh_history";
+      file = path.c_str();
+    }
+    history_open(file, HISTSIZE);
+  }
 
   //
   // Execute the shell's read/eval loop
@@ -110,301 +369,3284 @@ int main(int argc, char **argv)
       fflush(stdout);
     }
 
-    char cmdline[MAXLINE];
+    char *cmdline = readcmd();
 
-    if ((fgets(cmdline, MAXLINE, stdin) == NULL) && ferror(stdin)) {
-      app_error("fgets error");
-    }
     //
     // End of file? (did user type ctrl-d?)
     //
-    if (feof(stdin)) {
+    if (cmdline == NULL) {
       fflush(stdout);
       exit(0);
     }
 
+    //
+    // Expand a !event and remember the line
+    //
+    if (history_on) {
+      if ((cmdline = history_expand(cmdline)) == NULL)
+        continue;
+      history_add(cmdline, strlen(cmdline));
+    }
+
     //
     // Evaluate command line
     //
     eval(cmdline);
     fflush(stdout);
-    fflush(stdout);
   } 
 
   exit(0); //control never reaches here
 }
-  
+#endif /* TSH_NOMAIN */
+
 /////////////////////////////////////////////////////////////////////////////
 //
-// eval - Evaluate the command line that the user has just typed in
-// 
-// If the user has requested a built-in command (quit, jobs, bg or fg)
-// then execute it immediately. Otherwise, fork a child process and
-// run the job in the context of the child. If the job is running in
-// the foreground, wait for it to terminate and then return.  Note:
-// each child process must have a unique process group ID so that our
-// background children don't receive SIGINT (SIGTSTP) from the kernel
-// when we type ctrl-c (ctrl-z) at the keyboard.
+// tsh_init - Everything the shell needs before it can run a command.
 //
-void eval(char *cmdline) 
+void tsh_init(void)
 {
-  /* Parse command line */
+  sigset_t mask;
+  int sigfd;
+
   //
-  // The 'argv' vector is filled in by the parseline
-  // routine below. It provides the arguments needed
-  // for the execve() routine, which you'll need to
-  // use below to launch a process.
+  // Route the signals we handle through a signalfd in the event
+  // loop. They stay blocked for good, so no handler ever interrupts
+  // the shell; signal_event runs the *_handler routines from the
+  // main flow of control instead:
+  //
+  //   SIGINT  -> sigint_handler   (ctrl-c)
+  //   SIGTSTP -> sigtstp_handler  (ctrl-z)
+  //   SIGCHLD -> sigchld_handler  (stopped child; terminated ones
+  //                                are reaped through their pidfds)
+  //   SIGQUIT -> sigquit_handler  (a clean way to kill the shell)
   //
-  char *argv[MAXARGS];  //Argument list
-  pid_t PID;            //process id
-  sigset_t mask;        //block signals
 
-  
-  // The 'bg' variable is TRUE if the job should run
-  // in background mode or FALSE if it should run in FG
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGINT);
+  sigaddset(&mask, SIGTSTP);
+  sigaddset(&mask, SIGCHLD);
+  sigaddset(&mask, SIGQUIT);
+  sigprocmask(SIG_BLOCK, &mask, &childmask);
+
   //
+  // tsh -z: fork the zygote now, while the shell is at its smallest
+  // and before it has opened anything but 0, 1 and 2
+  //
+  if (launch_mode == LAUNCH_ZYGOTE && zygote_start() < 0)
+    launch_mode = LAUNCH_SPAWN;
+  if ((sigfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC)) < 0)
+    unix_error("signalfd error");
+  ev_init();
+  if (ev_add(sigfd, EPOLLIN, signal_event, NULL) < 0)
+    unix_error("ev_add error");
+
+  //
+  // Initialize the job list
+  //
+  initjobs(&jobs);
+  jobs.dropped = jobgone;
+
+  //
+  // tsh -v: trace events and latencies for the stats builtin, and
+  // write the events to $TSH_TRACE on the way out
+  //
+  if (verbose) {
+    trace_init(TRACE_EVENTS);
+    if (getenv("TSH_TRACE") != NULL)
+      atexit(trace_atexit);
+  }
+}
+
+//
+// trace_atexit - Dump the event trace to the file named by $TSH_TRACE
+//
+static void trace_atexit(void)
+{
+  const char *file = getenv("TSH_TRACE");
+  FILE *fp;
+
+  fflush(stdout);
+  if (file != NULL && (fp = fopen(file, "w")) != NULL) {
+    trace_dump(fp);
+    fclose(fp);
+  }
+}
+
   
-  
-  int bg = parseline(cmdline, argv); 
-  if(bg == -1)
+/////////////////////////////////////////////////////////////////////////////
+//
+// readcmd - Return the next line from stdin, ending in '\n', or NULL at
+// end of file. While no complete line is buffered it keeps the event
+// loop running, so jobs are reaped and reported while the shell sits
+// at the prompt. The line is valid until the next call.
+//
+// stdin is watched EPOLLONESHOT and re-armed only here: input that
+// is waiting while some other loop (waitfg, sleep, ...) runs must not
+// wake it over and over.
+//
+static void stdin_event(int fd, unsigned events, void *arg)
+{
+  *(int *)arg = 1;
+}
+
+char *readcmd(void)
+{
+  static char *buf, *held, heldc;
+  static size_t cap, start, end;
+  static int pollable = -1, ready, armed, eof;
+  char *line, *nl;
+  ssize_t r;
+
+  if(pollable < 0)
   {
-	  return;
+      stdincmds = 1;
+      /* epoll refuses regular files; those never block anyway */
+      pollable = (ev_add(0, EPOLLIN | EPOLLONESHOT, stdin_event, &ready) == 0);
+      armed = pollable;
   }
-  	
-  sigemptyset(&mask);
-  sigaddset(&mask, SIGCHLD);
-  sigaddset(&mask, SIGINT);
-  sigaddset(&mask, SIGTSTP);	 
-  	  
-  if(!builtin_cmd(argv)) 
+
+  /* The line is returned in place, NUL terminated by borrowing the
+   * byte after its newline; give that byte back */
+  if(held != NULL)
   {
-      sigprocmask(SIG_BLOCK, &mask, NULL);
-      /* Child process. PID = 0. */
- 
-      if((PID = fork()) == 0) //if there has been a fork
+      *held = heldc;
+      held = NULL;
+  }
+
+  for(;;)
+  {
+      if((nl = (char *)memchr(buf + start, '\n', end - start)) != NULL)
       {
-          sigprocmask(SIG_UNBLOCK, &mask, NULL);
-          setpgid(0, 0); //set group ID to PID
-          
-          if(execv(argv[0], argv) < 0) 
+          line = buf + start;
+          start = nl + 1 - buf;
+          held = nl + 1;      /* at most buf + end, and end < cap */
+          heldc = *held;
+          *held = '\0';
+          return line;
+      }
+      if(eof)
+      {
+          if(start == end)
           {
-              printf("%s: Command not found \n", argv[0]);
-              exit(0);
+              return NULL;
           }
+          buf[end++] = '\n';  /* last line had no newline; room was kept */
+          continue;
       }
- 
-          /* Parent process. PID = PID of child.
-          * If a foreground job, addjob and wait for completion. Otherwise, addjob and output jobs list. */
-          if(!bg)
+
+      /* Make room: slide the partial line to the front, and grow the
+       * buffer if it is one long line. Two bytes always stay free. */
+      if(start > 0)
+      {
+          memmove(buf, buf + start, end - start);
+          end -= start;
+          start = 0;
+      }
+      if(end + 2 >= cap)
+      {
+          cap = cap ? 2 * cap : 4 * MAXLINE;
+          if((buf = (char *)realloc(buf, cap)) == NULL)
           {
-              if(addjob(jobs, PID, FG, cmdline)) 
-              {
-                  sigprocmask(SIG_UNBLOCK, &mask, NULL);
-                  waitfg(PID); //wait until PID is no longer associated with fg job
-              }
+              app_error("readcmd: out of memory");
           }
-          else
+      }
+
+      if(pollable)
+      {
+          if(!armed && !ready)
           {
-              if(addjob(jobs, PID, BG, cmdline)) 
-              {
-                  sigprocmask(SIG_UNBLOCK, &mask, NULL);
-                  printf("[%d] (%d) %s", pid2jid(PID), PID, cmdline);
-              }
+              ev_mod(0, EPOLLIN | EPOLLONESHOT);
+              armed = 1;
+          }
+          while(!ready)
+          {
+              ev_wait(-1);
+              fflush(stdout);  /* job notifications */
+          }
+          ready = 0;
+          armed = 0;  //it fired, which disarmed it
+      }
+      else
+      {
+          ev_wait(0);
+          fflush(stdout);
+      }
+
+      if((r = read(0, buf + end, cap - end - 2)) < 0)
+      {
+          if(errno == EINTR || errno == EAGAIN)
+          {
+              continue;
           }
+          app_error("read error");
+      }
+      if(r == 0)
+      {
+          eof = 1;
+      }
+      end += r;
   }
-  
-  return;
 }
 
-
 /////////////////////////////////////////////////////////////////////////////
 //
-// builtin_cmd - If the user has typed a built-in command then execute
-// it immediately. The command name would be in argv[0] and
-// is a C string. We've cast this to a C++ string type to simplify
-// string comparisons; however, the do_bgfg routine will need 
-// to use the argv array as well to look for a job number.
+// batch_file - Run every line of a script file (tsh -f). The file is
+// mapped privately rather than read, so the lines are evaluated in
+// place and its size does not matter.
 //
-int builtin_cmd(char **argv) 
+void batch_file(const char *file)
 {
-	if (strcmp(argv[0], "quit") == 0) 
-	{
-        exit(0);
-    }
-    
-        else if (strcmp(argv[0], "jobs") == 0) 
-        {
-            listjobs(jobs);
-            return 1;
-        }
-        
-        else if (strcmp(argv[0], "bg") == 0 || strcmp(argv[0], "fg") == 0) 
-        {
-            do_bgfg(argv);
-            return 1;
-        }
-        
-        else if (strcmp(argv[0], "ls") == 0) 
-        {
-            argv[0] = "/bin/ls";
-            return 0;
-        }
-        
-        else if (strcmp(argv[0], "ps") == 0) 
-        {
-            argv[0] = "/bin/ps";
-            return 0;
-        }
-        
-        else
-        {
-            return 0;     /* not a builtin command */
-        }
-  //string cmd(argv[0]);
-  //return 0;     /* not a builtin command */
+  struct stat sb;
+  char *buf;
+  int fd;
+
+  if((fd = open(file, O_RDONLY | O_CLOEXEC)) < 0 || fstat(fd, &sb) < 0)
+  {
+      unix_error(file);
+  }
+  if(sb.st_size == 0)
+  {
+      close(fd);
+      return;
+  }
+  buf = (char *)mmap(NULL, sb.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if(buf == MAP_FAILED)
+  {
+      unix_error("mmap error");
+  }
+  madvise(buf, sb.st_size, MADV_SEQUENTIAL);
+  batch_run(buf, sb.st_size);
+  munmap(buf, sb.st_size);
 }
 
 /////////////////////////////////////////////////////////////////////////////
 //
-// do_bgfg - Execute the builtin bg and fg commands
+// batch_run - Evaluate each line of buf[0..len) in turn. eval() wants a
+// NUL-terminated line ending in '\n', so the byte after each newline
+// is swapped for a NUL for the duration of the call; only the last
+// line, which has no byte after it, is copied. Output is left to stdio's buffer
+// (eval flushes it before starting children) and written out every
+// BATCHFLUSH lines rather than after every command; background jobs
+// are reaped at the same points.
 //
-void do_bgfg(char **argv) 
-{
-	struct job_t *job = NULL;
-        pid_t pid;
-        int jid;
- 
-        if(argv[1] == NULL) // ex -> ls -l.  -l is argv[1]
-        {
-            printf("%s command requires PID or %%jobid argument \n");
-            return;
-        }
- 
-        /* The following if-else statements fetch the job to be worked on. */
-        if(argv[1][0] == '%') 
-        {
-           /* Argument begins with '%', so it's a JID. */
-           jid = atoi(&argv[1][1]); // converts string to integer
-           job = getjobjid(jobs, jid); //get JID
- 
-           if(job == NULL) //if JID is null
-           {
-               printf("%d: No such job \n", jid);
-               return;
-           }
-        }
-        
-        else if(isdigit(argv[1][0])) 
-        {
-            /* Argument begins with a digit, so it's a PID. */
-            pid = atoi(argv[1]);
-            job = getjobpid(jobs, pid); //get PID
- 
-            if(job == NULL) //if PID is null
-            {
-                printf("(%d): No such process \n", pid);
-                return;
-            }
-        }
-        
-        else
-        {
-            printf("%s: argument must be a PID or %%jobid \n");
-            return;
-        }
- 
-        /* Set pid and jid to that of the job to be worked on. */
-        pid = job->pid;
-        jid = job->jid;
- 
-        /* The following if-else statements perform actions on the job based on the command entered. */
-        if(strcmp("bg", argv[0]) == 0) 
-        {
-            /* Command entered was BG. If job's state is stopped, continue in the background. */
-            if(job->state == ST) 
-            {
-                if(kill(-pid, SIGCONT) < 0) 
-                {
-                    printf("An error has occurred in kill. \n");
-                }
-                    job->state = BG;
-                    printf("[%d] (%d) %s", jid, pid, job->cmdline);
-            }
-                
-                else
-                {
-                    printf("This job is already running in the background. \n");
-                    return;
-                }
-        }
-        
-        else
-        {
-            if(kill(-pid, SIGCONT) < 0) 
-            {
-                printf("An error has occurred in kill. \n");
-            }
-                job->state = FG;
-                waitfg(pid); //wait until pid is no longer associated with FG
-        }
-        
-        return;
-}
+#define BATCHFLUSH 256
 
-/////////////////////////////////////////////////////////////////////////////
-//
-// waitfg - Block until process pid is no longer the foreground process
-//wait until given pid is no longer associated with fg job
-void waitfg(pid_t pid)
+void batch_run(char *buf, size_t len)
 {
-	struct job_t *fgjob = getjobpid(jobs, pid);
- 
-        /* Job no longer exists in current job list. */
-        if(getjobpid(jobs, pid) == NULL)
-        { return; }
- 
-        while(fgjob->state == FG && fgjob->pid == pid)
-        { sleep(1); }
- 
-        return;
+  char *line = buf, *end = buf + len, *nl, *p, *last, save;
+  size_t n;
+  int count = 0;
+
+  while(line < end)
+  {
+      if((nl = (char *)memchr(line, '\n', end - line)) == NULL ||
+         nl + 1 == end)
+      {
+          /* Last line: no byte after it to borrow, maybe no newline
+           * either; evaluate a copy */
+          n = end - line;
+          if((last = (char *)malloc(n + 2)) == NULL)
+          {
+              app_error("batch: out of memory");
+          }
+          memcpy(last, line, n);
+          if(nl == NULL)
+          {
+              last[n++] = '\n';
+          }
+          last[n] = '\0';
+          for(p = last; *p == ' ' || *p == '\t'; p++)
+              ;
+          if(*p != '\n' && *p != '#')
+          {
+              eval(last);
+          }
+          free(last);
+          break;
+      }
+
+      for(p = line; p < nl && (*p == ' ' || *p == '\t'); p++)
+          ;
+      if(p == nl || *p == '#')
+      {
+          /* blank line or comment */
+      }
+      else
+      {
+          save = nl[1];
+          nl[1] = '\0';
+          eval(line);
+          nl[1] = save;
+      }
+
+      if(++count % BATCHFLUSH == 0)
+      {
+          ev_wait(0);  /* reap and report background jobs */
+          fflush(stdout);
+      }
+      line = nl + 1;
+  }
 }
 
 /////////////////////////////////////////////////////////////////////////////
 //
-// Signal handlers
+// eval - Evaluate the command line that the user has just typed in
+// 
+// The line is compiled (or found already compiled) into a tree of
+// pipelines joined by ;, &, && and || (see compile) and run by
+// runnode, which hands each pipeline to runcmd. && and || look at
+// lastexit, the exit status of the last foreground command. A
+// foreground job that is stopped or interrupted ends the line there.
 //
+void eval(char *cmdline) 
+{
+  struct node_t *root;
+  long long t0 = trace_on ? trace_now() : 0;
 
+  if((root = compile(cmdline)) == NULL) //blank line, or an error already reported
+  {
+      return;
+  }
+  trace(TR_PARSE, 0, 0, trace_on ? trace_now() - t0 : 0);
+  fgintr = 0;
+  runnode(root);
+  dagrun();  //kill may have dropped a job in the after graph
+}
 
 /////////////////////////////////////////////////////////////////////////////
 //
-// sigchld_handler - The kernel sends a SIGCHLD to the shell whenever
-//     a child job terminates (becomes a zombie), or stops because it
-//     received a SIGSTOP or SIGTSTP signal. The handler reaps all
-//     available zombie children, but doesn't wait for any other
-//     currently running children to terminate.  
+// runnode - Run the (sub)tree n of a compiled line
+//
+void runnode(struct node_t *n)
+{
+  struct jobstats_t ts;
+  struct rusage self, kids, ru;
+  long k;
+
+  switch(n->type)
+  {
+  case N_PIPE:
+      runcmd(&n->cmd, n->text);
+      break;
+  case N_SEQ:
+      runnode(n->left);
+      if(!fgintr)
+      {
+          runnode(n->right);
+      }
+      break;
+  case N_AND:
+  case N_OR:
+      runnode(n->left);
+      if(!fgintr && (lastexit == 0) == (n->type == N_AND))
+      {
+          runnode(n->right);
+      }
+      break;
+  case N_REPEAT:
+      lastexit = 0;
+      for(k = 0; k < n->count && !fgintr; k++)
+      {
+          runnode(n->left);
+      }
+      break;
+  case N_TIME:
+      /* what the shell and its reaped children used in between */
+      memset(&ts, 0, sizeof(ts));
+      clock_gettime(CLOCK_REALTIME, &ts.start);
+      getrusage(RUSAGE_SELF, &self);
+      getrusage(RUSAGE_CHILDREN, &kids);
+      runnode(n->left);
+      clock_gettime(CLOCK_REALTIME, &ts.end);
+      getrusage(RUSAGE_SELF, &ts.ru);
+      rusage_since(&ts.ru, &self);
+      getrusage(RUSAGE_CHILDREN, &ru);
+      rusage_since(&ru, &kids);
+      addrusage(&ts.ru, &ru);
+      print_time(&ts);
+      break;
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// runcmd - Run one parsed pipeline, whose text is cmdline
+// 
+// If the user has requested a built-in command (quit, jobs, bg or fg)
+// then execute it immediately. Otherwise, start a child process for
+// each stage of the (possibly one-stage) pipeline and make them one
+// job. If the job is running in
+// the foreground, wait for it to terminate and then return.  Note:
+// each child process must have a unique process group ID so that our
+// background children don't receive SIGINT (SIGTSTP) from the kernel
+// when we type ctrl-c (ctrl-z) at the keyboard.
+//
+void runcmd(struct cmd_t *c, const char *cmdline)
+{
+  char **args = c->args;    //argument list, without a leading "time"
+  int handled = 0;          //run by the shell itself?
+  int saved[3];             //the shell's own 0..2 while redirected
+  const struct builtin_t *b = NULL;
+  struct job_t *job;
+  pid_t pid;
+  int jid;
+  struct jobstats_t ts;     //resource use measured here for builtins
+  struct rusage self;
+  long long t0 = trace_on ? trace_now() : 0;
+
+  
+  // The 'bg' flag (c->bg) is TRUE if the job should run
+  // in background mode or FALSE if it should run in FG
+  //
+  
+  
+  if(c->nstages == 0) //a lone "time"
+  {
+      lastexit = 0;
+      return;
+  }
+
+  // "time cmd" runs cmd as usual and then prints what it used
+  if(c->timed)
+  {
+      memset(&ts, 0, sizeof(ts));
+      clock_gettime(CLOCK_REALTIME, &ts.start);
+      getrusage(RUSAGE_SELF, &self);
+  }
+  	
+  lastexit = 0;  //what a builtin or a bg job gets, unless it says otherwise
+  if(c->timeout > 0)
+  {
+      //a deadline needs a process to kill: never run in the shell
+  }
+  else if(c->nstages == 1 && c->stageredir[1] == 0)
+  {
+      handled = builtin_cmd(args, !c->bg);
+  }
+  else if(c->nstages == 1 && (args[0] == NULL || (b = builtin_lookup(args)) != NULL))
+  {
+      /* "jobs > file", "> file": the shell's own descriptors are
+       * redirected just for the command. A native utility is not run
+       * here but in a child, by launch_stage, like any program. */
+      handled = 1;
+      if(b != NULL && (b->flags & B_INFILE) && c->stageredir[1] == 1 &&
+         c->redirs[0].fd == 0 && c->redirs[0].path != NULL)
+      {
+          if((builtinin = open(c->redirs[0].path, O_RDONLY | O_CLOEXEC)) < 0)
+          {
+              printf("%s: %s\n", c->redirs[0].path, strerror(errno));
+              lastexit = 1;
+          }
+          else
+          {
+              b->fn(args);
+              close(builtinin);
+              builtinin = -1;
+          }
+      }
+      else if(b != NULL && !(b->flags & B_REDIR))
+      {
+          printf("%s: a builtin that starts or waits for jobs cannot be redirected\n",
+                 args[0]);
+          lastexit = 1;
+      }
+      else
+      {
+          if(redirect_shell(c->redirs, c->stageredir[1], saved) == 0 && args[0] != NULL)
+          {
+              shellredir = 1;
+              b->fn(args);
+              shellredir = 0;
+          }
+          restore_shell(saved);
+      }
+  }
+
+  if(handled)
+  {
+      if(trace_on && !c->bg)  //a builtin's turnaround counts too
+      {
+          hist_add(&hist_fg, trace_now() - t0);
+          trace(TR_FGDONE, 0, 0, trace_now() - t0);
+      }
+      if(c->timed)
+      {
+          /* A builtin ran in the shell itself; charge it the shell's use */
+          clock_gettime(CLOCK_REALTIME, &ts.end);
+          getrusage(RUSAGE_SELF, &ts.ru);
+          rusage_since(&ts.ru, &self);
+          print_time(&ts);
+      }
+  }
+  else if(c->bg && (jobs.qhead != NULL ||
+                    (joblimit > 0 && jobs.nstate[BG] + jobs.nstate[FG] >= joblimit)))
+  {
+      /* Over the job limit: wait in line; admit starts it later */
+      if((job = newjob(&jobs, cmdline)) != NULL)
+      {
+          queuejob(&jobs, job);
+          printf("[%d] (queued) %s", job->jid, cmdline);
+      }
+  }
+  else if((job = runjob(c, cmdline, NULL, c->bg ? BG : FG)) != NULL)
+  {
+      /* job->pid leads the job's process group. If a foreground
+       * job, wait for completion. Otherwise, output jobs list. */
+      if(!c->bg)
+      {
+          pid = job->pid;  //job may be gone and reused by the time waitfg returns
+          jid = job->jid;
+          waitfg(pid); //wait until the job is no longer the fg job; sets lastexit
+          if(trace_on)
+          {
+              hist_add(&hist_fg, trace_now() - t0);
+              trace(TR_FGDONE, pid, jid, trace_now() - t0);
+          }
+          if(c->timed && fgstats_pid == pid) //it finished (not stopped)
+          {
+              print_time(&fgstats);
+          }
+      }
+      else
+      {
+          printf("[%d] (%d) %s", job->jid, job->pid, cmdline);
+      }
+  }
+  else
+  {
+      lastexit = 127;  //nothing could be started
+  }
+  
+  return;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// rusage_since - Take what was used up to was off ru: the times and
+// counts print_time shows
+//
+static void rusage_since(struct rusage *ru, const struct rusage *was)
+{
+  ru->ru_utime.tv_sec -= was->ru_utime.tv_sec;
+  ru->ru_utime.tv_usec -= was->ru_utime.tv_usec;
+  ru->ru_stime.tv_sec -= was->ru_stime.tv_sec;
+  ru->ru_stime.tv_usec -= was->ru_stime.tv_usec;
+  ru->ru_nvcsw -= was->ru_nvcsw;
+  ru->ru_nivcsw -= was->ru_nivcsw;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// compile - The tree for cmdline, from the line cache or parsed now
+// into the cache slot its hash picks. NULL for a blank line, or after
+// printing what is wrong with it (lastexit is then 2). The tree is
+// valid until the next call.
+//
+// Grammar, over the tokens of tokenize.h (| & ; ( and ) end a word,
+// so "(a; b)" is "( a ; b )"; < and > are only operators at the
+// start of one):
+//
+//   list     := andor ((";" | "&") andor)* [";" | "&"]
+//   andor    := term (("&&" | "||") term)*
+//   term     := "(" list ")" | "repeat" N term | "time" term
+//             | pipeline
+//
+// Only a pipeline can be put in the background with "&"; a group or
+// an && / || list would need a subshell, which tsh does not have.
+//
+static struct node_t *parselist(struct line_t *l, int *i);
+static struct node_t *parseandor(struct line_t *l, int *i);
+static struct node_t *parseterm(struct line_t *l, int *i);
+
+struct node_t *compile(const char *cmdline)
+{
+  static struct line_t cache[LINECACHE];
+  size_t len = strlen(cmdline);
+  unsigned long long h = 14695981039346656037ULL;
+  struct line_t *l;
+  struct node_t *root = NULL, *n;
+  size_t i, need;
+  char *t;
+  int ntoks, k;
+
+  for(i = 0; i < len; i++)  //FNV-1a
+  {
+      h = (h ^ (unsigned char)cmdline[i]) * 1099511628211ULL;
+  }
+  h |= 1;  //never 0
+  l = &cache[h % LINECACHE];
+  if(l->hash == h && memcmp(l->line, cmdline, len + 1) == 0)
+  {
+      return &l->nodes[l->nnodes - 1];
+  }
+
+  l->hash = 0;
+  if((ntoks = tokenize_line(cmdline, len, &l->toks)) < 0)
+  {
+      printf("syntax error: unterminated quote\n");
+      lastexit = 2;
+      return NULL;
+  }
+  if(ntoks == 0)
+  {
+      return NULL;
+  }
+
+  /* Room for the worst case: every token a node, a stage, ... */
+  need = len + 2 * ntoks + 2;
+  if(ntoks + 1 > l->cap || len + 1 > l->linecap || need > l->textcap)
+  {
+      l->cap = ntoks + 1 > l->cap ? 2 * (ntoks + 1) : l->cap;
+      l->linecap = len + 1 > l->linecap ? 2 * (len + 1) : l->linecap;
+      l->textcap = need > l->textcap ? 2 * need : l->textcap;
+      l->nodes = (struct node_t *)realloc(l->nodes, l->cap * sizeof(struct node_t));
+      l->stagev = (char ***)realloc(l->stagev, l->cap * sizeof(char **));
+      l->pids = (pid_t *)realloc(l->pids, l->cap * sizeof(pid_t));
+      l->redirs = (struct redir_t *)realloc(l->redirs, l->cap * sizeof(struct redir_t));
+      l->stageredir = (int *)realloc(l->stageredir, l->cap * sizeof(int));
+      l->line = (char *)realloc(l->line, l->linecap);
+      l->texts = (char *)realloc(l->texts, l->textcap);
+      if(l->nodes == NULL || l->stagev == NULL || l->pids == NULL ||
+         l->redirs == NULL || l->stageredir == NULL || l->line == NULL ||
+         l->texts == NULL)
+      {
+          app_error("eval: out of memory");
+      }
+  }
+  l->nnodes = 0;
+
+  k = 0;
+  if((root = parselist(l, &k)) != NULL && k < ntoks)  //a ")" too many
+  {
+      printf("syntax error near ')'\n");
+      root = NULL;
+  }
+  if(root == NULL)
+  {
+      lastexit = 2;
+      return NULL;
+  }
+
+  /* A pipeline on its own is the line; one in a list is its part of
+   * it, with the "&" if it has one */
+  memcpy(l->line, cmdline, len + 1);
+  t = l->texts;
+  for(n = l->nodes; n < l->nodes + l->nnodes; n++)
+  {
+      if(n->type != N_PIPE)
+      {
+          continue;
+      }
+      if(n == root)
+      {
+          n->text = l->line;
+          break;
+      }
+      i = l->toks.pos[n->end] + (n->cmd.bg ? 1 : 0);
+      while(i > (size_t)l->toks.pos[n->first] && isspace((unsigned char)cmdline[i - 1]))
+      {
+          i--;
+      }
+      n->text = t;
+      memcpy(t, cmdline + l->toks.pos[n->first], i - l->toks.pos[n->first]);
+      t += i - l->toks.pos[n->first];
+      *t++ = '\n';
+      *t++ = '\0';
+  }
+  l->hash = h;
+  return root;
+}
+
+//
+// newnode - The next node of l's tree
+//
+static struct node_t *newnode(struct line_t *l, int type, struct node_t *left,
+                              struct node_t *right)
+{
+  struct node_t *n = &l->nodes[l->nnodes++];
+
+  n->type = type;
+  n->left = left;
+  n->right = right;
+  return n;
+}
+
+//
+// synerr - Say that the line goes wrong at token i
+//
+static struct node_t *synerr(struct line_t *l, int i)
+{
+  static const char *opname[] = {
+    NULL, "|", "&", ";", "<", ">", ">>", "&&", "||", "(", ")", NULL
+  };
+  const char *near = "newline";
+
+  if(i < l->toks.ntoks)
+  {
+      near = l->toks.kind[i] == TOK_WORD || l->toks.kind[i] == TOK_DUP ?
+             l->toks.argv[i] : opname[l->toks.kind[i]];
+  }
+  printf("syntax error near '%s'\n", near);
+  return NULL;
+}
+
+static struct node_t *parselist(struct line_t *l, int *i)
+{
+  const unsigned char *kind = l->toks.kind;
+  struct node_t *left, *last;
+  int ntoks = l->toks.ntoks;
+
+  if((left = last = parseandor(l, i)) == NULL)
+  {
+      return NULL;
+  }
+  while(*i < ntoks && (kind[*i] == TOK_SEMI || kind[*i] == TOK_BG))
+  {
+      if(kind[*i] == TOK_BG)
+      {
+          if(last->type != N_PIPE)
+          {
+              printf("syntax error: only a pipeline can be run in the background\n");
+              return NULL;
+          }
+          last->cmd.bg = 1;
+      }
+      if(++*i == ntoks || kind[*i] == TOK_RPAREN)
+      {
+          break;
+      }
+      if((last = parseandor(l, i)) == NULL)
+      {
+          return NULL;
+      }
+      left = newnode(l, N_SEQ, left, last);
+  }
+  if(*i < ntoks && kind[*i] != TOK_RPAREN)
+  {
+      return synerr(l, *i);
+  }
+  return left;
+}
+
+static struct node_t *parseandor(struct line_t *l, int *i)
+{
+  const unsigned char *kind = l->toks.kind;
+  struct node_t *left, *right;
+  int op;
+
+  if((left = parseterm(l, i)) == NULL)
+  {
+      return NULL;
+  }
+  while(*i < l->toks.ntoks && (kind[*i] == TOK_AND || kind[*i] == TOK_OR))
+  {
+      op = kind[(*i)++] == TOK_AND ? N_AND : N_OR;
+      if((right = parseterm(l, i)) == NULL)
+      {
+          return NULL;
+      }
+      left = newnode(l, op, left, right);
+  }
+  return left;
+}
+
+static struct node_t *parseterm(struct line_t *l, int *i)
+{
+  char **argv = l->toks.argv;
+  const unsigned char *kind = l->toks.kind;
+  int ntoks = l->toks.ntoks, first = *i;
+  struct node_t *n, *body;
+  char *end;
+  long count;
+
+  if(first == ntoks)
+  {
+      return synerr(l, first - 1);  //nothing after && or ||
+  }
+  if(kind[first] == TOK_LPAREN)
+  {
+      ++*i;
+      if((body = parselist(l, i)) == NULL)
+      {
+          return NULL;
+      }
+      if(*i == ntoks)
+      {
+          printf("syntax error: '(' without ')'\n");
+          return NULL;
+      }
+      ++*i;
+      return body;
+  }
+  if(kind[first] == TOK_WORD && strcmp(argv[first], "repeat") == 0)
+  {
+      if(first + 2 >= ntoks || kind[first + 1] != TOK_WORD ||
+         (count = strtol(argv[first + 1], &end, 10)) < 0 || *end != '\0' ||
+         end == argv[first + 1])
+      {
+          printf("repeat: usage: repeat COUNT command\n");
+          return NULL;
+      }
+      *i += 2;
+      if((body = parseterm(l, i)) == NULL)
+      {
+          return NULL;
+      }
+      n = newnode(l, N_REPEAT, body, NULL);
+      n->count = count;
+      return n;
+  }
+  if(kind[first] == TOK_WORD && strcmp(argv[first], "time") == 0 && first + 1 < ntoks &&
+     (kind[first + 1] == TOK_LPAREN ||
+      (kind[first + 1] == TOK_WORD && strcmp(argv[first + 1], "repeat") == 0)))
+  {
+      ++*i;
+      if((body = parseterm(l, i)) == NULL)
+      {
+          return NULL;
+      }
+      return newnode(l, N_TIME, body, NULL);
+  }
+
+  /* A pipeline: everything up to the next list operator */
+  while(*i < ntoks && kind[*i] != TOK_SEMI && kind[*i] != TOK_BG &&
+        kind[*i] != TOK_AND && kind[*i] != TOK_OR &&
+        kind[*i] != TOK_LPAREN && kind[*i] != TOK_RPAREN)
+  {
+      ++*i;
+  }
+  if(*i == first)
+  {
+      return synerr(l, first);
+  }
+  argv[*i] = NULL;  //the operator's text is static; kind still says what it was
+  n = newnode(l, N_PIPE, NULL, NULL);
+  n->first = first;
+  n->end = *i;
+  n->cmd.stagev = l->stagev + first;
+  n->cmd.pids = l->pids + first;
+  n->cmd.redirs = l->redirs + first;
+  n->cmd.stageredir = l->stageredir + first;
+  n->cmd.stagecap = *i - first + 1;
+  if(parseargs(&n->cmd, argv + first, kind + first, *i - first, 0) < 0)
+  {
+      return NULL;
+  }
+  return n;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// parsecmd - Tokenize cmdline, a single pipeline, into c and take it
+// apart (see parseargs). Returns the number of stages, 0 for a blank
+// line or -1 after printing what is wrong with it.
+//
+int parsecmd(const char *cmdline, struct cmd_t *c)
+{
+  char **argv;                   //all the tokens
+  unsigned char *kind;           //TOK_* of each argument
+  int ntoks, bg;
+
+  if((ntoks = tokenize_line(cmdline, strlen(cmdline), &c->toks)) < 0)
+  {
+      printf("syntax error: unterminated quote\n");
+      return -1;
+  }
+  argv = c->toks.argv;
+  kind = c->toks.kind;
+  if(ntoks + 1 > c->stagecap)
+  {
+      c->stagecap = 2 * (ntoks + 1);
+      c->stagev = (char ***)realloc(c->stagev, c->stagecap * sizeof(char **));
+      c->pids = (pid_t *)realloc(c->pids, c->stagecap * sizeof(pid_t));
+      c->redirs = (struct redir_t *)realloc(c->redirs, c->stagecap * sizeof(struct redir_t));
+      c->stageredir = (int *)realloc(c->stageredir, c->stagecap * sizeof(int));
+      if(c->stagev == NULL || c->pids == NULL || c->redirs == NULL ||
+         c->stageredir == NULL)
+      {
+          app_error("eval: out of memory");
+      }
+  }
+
+  bg = (ntoks > 0 && kind[ntoks - 1] == TOK_BG);
+  if(bg)
+  {
+      argv[--ntoks] = NULL;
+  }
+  return parseargs(c, argv, kind, ntoks, bg);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// parseargs - Take apart the pipeline argv[0..ntoks) (NULL terminated)
+// into c, whose arrays have room for ntoks + 1 entries: a leading
+// "time", a "timeout DUR" prefix, the pipeline stages and their
+// redirections. Returns the number of stages or -1 after printing
+// what is wrong.
+//
+int parseargs(struct cmd_t *c, char **argv, const unsigned char *kind, int ntoks,
+              int bg)
+{
+  c->args = argv;
+  c->bg = bg;
+
+  c->timed = (argv[0] != NULL && kind[0] == TOK_WORD && strcmp(argv[0], "time") == 0);
+  if(c->timed)
+  {
+      c->args++;
+      kind++;
+  }
+
+  // "timeout DUR cmd" runs cmd as a job with a deadline (0: none)
+  c->timeout = 0;
+  if(c->args[0] != NULL && kind[0] == TOK_WORD && strcmp(c->args[0], "timeout") == 0)
+  {
+      double secs;
+
+      if(c->args[1] == NULL || c->args[2] == NULL || kind[2] != TOK_WORD)
+      {
+          printf("timeout: usage: timeout DURATION command [arg ...]\n");
+          return -1;
+      }
+      if(dur_parse(c->args[1], &secs) < 0)
+      {
+          printf("timeout: invalid time interval '%s'\n", c->args[1]);
+          return -1;
+      }
+      c->timeout = secs > 0 && secs < 0.001 ? 1 : (long long)(secs * 1000);
+      c->args += 2;
+      kind += 2;
+  }
+
+  if((c->nstages = splitpipeline(c->args, kind, c->stagev)) < 0)
+  {
+      printf("syntax error near '|' \n");
+      return -1;
+  }
+  if(c->nstages > 0 &&
+     splitredirs(c->args, kind, c->stagev, c->nstages, c->redirs, c->stageredir) < 0)
+  {
+      return -1;
+  }
+  return c->nstages;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// runjob - Start the parsed command c as a job in the given state: in
+// job if it is a reserved or queued record, else in a new one. The
+// record is made before anything is forked, so no child is ever left
+// without a job. Returns the job, or NULL if nothing could be started
+// (the record is then dropped).
+//
+struct job_t *runjob(struct cmd_t *c, const char *cmdline, struct job_t *job,
+                     int state)
+{
+  int opfd[2] = { -1, -1 }; //output pipe of a captured bg job
+  struct place_t place;
+  int nprocs, i, cpu;
+
+  if(job == NULL && (job = newjob(&jobs, cmdline)) == NULL)
+  {
+      return NULL;
+  }
+
+  /* Where it runs: what affinity and nice said before it started,
+   * else (tsh -a) a bg job gets a CPU of its own if there is one */
+  place = job->info->place;
+  if(state == BG && !(place.flags & PL_CPUS) && (cpu = place_pick()) >= 0)
+  {
+      job->info->cpu = cpu + 1;  //given back when the job goes
+      CPU_ZERO(&place.cpus);
+      CPU_SET(cpu, &place.cpus);
+      place.flags |= PL_CPUS;
+  }
+
+  /* Children write to our stdout too; get ours out first */
+  fflush(stdout);
+
+  /* tsh -o: a bg job writes into a pipe that the event loop
+   * drains into the job's ring buffer instead of onto our stdout.
+   * Only the shell's end is non-blocking. */
+  if(state == BG && capture)
+  {
+      if(pipe2(opfd, O_CLOEXEC) < 0)
+      {
+          printf("pipe error: %s\n", strerror(errno));
+          dropjob(&jobs, job);
+          return NULL;
+      }
+      fcntl(opfd[0], F_SETFL, O_NONBLOCK);
+  }
+
+  /* No need to block signals here: SIGCHLD is only acted on from
+   * the event loop, which cannot run before the job is started. */
+  nprocs = launch_pipeline(c->stagev, c->nstages, c->redirs, c->stageredir,
+                           opfd[1], place.flags != 0 ? &place : NULL,
+                           &childmask, c->pids);
+  if(opfd[1] >= 0)
+  {
+      close(opfd[1]);
+  }
+  if(nprocs == 0 || !startjob(&jobs, job, c->pids[0], state))
+  {
+      if(opfd[0] >= 0)
+      {
+          close(opfd[0]);
+      }
+      dropjob(&jobs, job);
+      return NULL;
+  }
+
+  for(i = 1; i < nprocs; i++)
+  {
+      addjobpid(&jobs, job, c->pids[i]);
+  }
+  watchjob(job);
+  if(c->timeout > 0)
+  {
+      setdeadline(job, c->timeout);
+  }
+  if(opfd[0] >= 0)
+  {
+      if((job->info->out = outring_new(opfd[0], OUTRING)) == NULL)
+      {
+          close(opfd[0]); //out of memory: the output is lost
+      }
+      else if(ev_add(opfd[0], EPOLLIN, output_event, job) < 0)
+      {
+          outring_free(job->info->out);
+          job->info->out = NULL;
+      }
+  }
+  return job;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// startqueued - Start a queued job now, in state BG or FG, whatever
+// the job limit says. Returns the job, or NULL if it could not be
+// started (it is then gone from the job list).
+//
+struct job_t *startqueued(struct job_t *job, int state)
+{
+  static struct cmd_t cmd;  //not eval's: this may run while eval waits
+
+  if(parsecmd(job->cmdline, &cmd) <= 0)
+  {
+      dropjob(&jobs, job);
+      return NULL;
+  }
+  if((job = runjob(&cmd, job->cmdline, job, state)) != NULL && state == BG)
+  {
+      printf("[%d] (%d) %s", job->jid, job->pid, job->cmdline);
+  }
+  return job;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// admit - Start queued jobs, oldest first, while fewer than joblimit
+// jobs are running. Called whenever a running job finishes or stops
+// and when the limit changes.
+//
+void admit(void)
+{
+  while(jobs.qhead != NULL &&
+        (joblimit == 0 || jobs.nstate[BG] + jobs.nstate[FG] < joblimit))
+  {
+      startqueued(jobs.qhead, BG);
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// splitpipeline - Cut argv at each "|" operator into the argv of every
+// stage; a quoted '|' is an ordinary word. stagev needs room for one
+// more entry than argv has. Returns the number of stages, or -1 if a
+// stage is empty.
+//
+int splitpipeline(char **argv, const unsigned char *kind, char ***stagev)
+{
+  int n = 0, i;
+
+  if(argv[0] == NULL)
+  {
+      return 0;
+  }
+
+  stagev[n++] = argv;
+  for(i = 0; argv[i] != NULL; i++)
+  {
+      if(kind[i] == TOK_PIPE)
+      {
+          argv[i] = NULL;
+          if(argv[i + 1] == NULL || stagev[n - 1] == &argv[i])
+          {
+              return -1;
+          }
+          stagev[n++] = &argv[i + 1];
+      }
+  }
+  return n;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// splitredirs - Take the redirections (< > >> and [N]>&M, see
+// tokenize.h) out of each stage's argv, closing the gaps, and collect
+// them in order in redirs[]: stage i's are stageredir[i] up to
+// stageredir[i + 1]. redirs needs room for as many entries as argv
+// has and stageredir for nstages + 1. Returns the total, or -1 after
+// printing what is wrong.
+//
+int splitredirs(char **argv, const unsigned char *kind, char ***stagev,
+                int nstages, struct redir_t *redirs, int *stageredir)
+{
+  const unsigned char *k;
+  char **v, **w, *op;
+  int n = 0, i;
+
+  for(i = 0; i < nstages; i++)
+  {
+      stageredir[i] = n;
+      k = kind + (stagev[i] - argv);
+      for(v = w = stagev[i]; *v != NULL; v++, k++)
+      {
+          op = *v;
+          if(*k == TOK_DUP)
+          {
+              redirs[n].fd = op[0] == '>' ? 1 : op[0] - '0';
+              redirs[n].dupfd = op[strlen(op) - 1] - '0';
+              redirs[n].path = NULL;
+              if(redirs[n].dupfd > 2) //the shell's own descriptors are off limits
+              {
+                  printf("%s: Bad file descriptor\n", op);
+                  return -1;
+              }
+              n++;
+              continue;
+          }
+          if(*k != TOK_IN && *k != TOK_OUT && *k != TOK_APPEND)
+          {
+              *w++ = op; //a word, or an operator eval doesn't handle yet
+              continue;
+          }
+          if(v[1] == NULL || k[1] != TOK_WORD)
+          {
+              printf("syntax error near '%s'\n", v[1] == NULL ? "newline" : v[1]);
+              return -1;
+          }
+          redirs[n].fd = isdigit((unsigned char)op[0]) ? op[0] - '0' : *k == TOK_IN ? 0 : 1;
+          redirs[n].flags = *k == TOK_IN ? O_RDONLY :
+                            *k == TOK_OUT ? O_WRONLY | O_CREAT | O_TRUNC :
+                            O_WRONLY | O_CREAT | O_APPEND;
+          redirs[n].path = *++v;
+          k++;
+          n++;
+      }
+      *w = NULL;
+      if(stagev[i][0] == NULL && nstages > 1)
+      {
+          printf("syntax error near '|' \n");
+          return -1;
+      }
+  }
+  stageredir[nstages] = n;
+  return n;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// redirect_shell - Apply redirections to the shell's own descriptors
+// for a command the shell runs itself, saving the originals in
+// saved[0..2] (close-on-exec copies) for restore_shell, which must be
+// called even if this fails. Returns -1 after printing the error if a
+// file cannot be opened.
+//
+int redirect_shell(const struct redir_t *redirs, int nredirs, int *saved)
+{
+  int i, fd;
+
+  fflush(stdout);
+  for(i = 0; i < 3; i++)
+  {
+      saved[i] = fcntl(i, F_DUPFD_CLOEXEC, 10);
+  }
+  for(i = 0; i < nredirs; i++)
+  {
+      if(redirs[i].path == NULL)
+      {
+          dup2(redirs[i].dupfd, redirs[i].fd);
+          continue;
+      }
+      if((fd = open(redirs[i].path, redirs[i].flags | O_CLOEXEC, 0666)) < 0)
+      {
+          fprintf(stderr, "%s: %s\n", redirs[i].path, strerror(errno));
+          return -1;
+      }
+      dup2(fd, redirs[i].fd);
+      close(fd);
+  }
+  return 0;
+}
+
+void restore_shell(int *saved)
+{
+  int i;
+
+  fflush(stdout);
+  for(i = 0; i < 3; i++)
+  {
+      if(saved[i] >= 0)
+      {
+          dup2(saved[i], i);
+          close(saved[i]);
+      }
+  }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// launch_stage - Start one pipeline stage with the given descriptors.
+// A "cat" with only file arguments, or inside a pipeline a "tee" with
+// only file arguments, runs as a forked copy of the shell that moves
+// the data with copy_file_range, sendfile, splice and tee(2) instead
+// of exec'ing the real program; so does any of the native utilities
+// (utils.h) that could not run in the shell itself. Returns the PID,
+// or -1 after printing why it could not be started.
+//
+pid_t launch_stage(char **argv, pid_t pgid, const struct childio_t *io,
+                   const sigset_t *childmask, int inpipe)
+{
+  const char *path;
+  utilfn_t *fn;
+  pid_t pid;
+  int i;
+
+  if((fn = util_lookup(argv[0])) != NULL)
+  {
+      return launch_func(fn, argv, pgid, io, childmask);
+  }
+  if(!util_external && strcmp(argv[0], "cat") == 0)
+  {
+      for(i = 1; argv[i] != NULL && (argv[i][0] != '-' || argv[i][1] == '\0'); i++)
+          ;
+      if(argv[i] == NULL)
+      {
+          return launch_func(cat_main, argv, pgid, io, childmask);
+      }
+  }
+  if(!util_external && inpipe && strcmp(argv[0], "tee") == 0)
+  {
+      for(i = 1; argv[i] != NULL && argv[i][0] != '-'; i++)
+          ;
+      if(argv[i] == NULL)
+      {
+          return launch_func(tee_main, argv, pgid, io, childmask);
+      }
+  }
+
+  if((path = pathcache_lookup(argv[0])) == NULL)
+  {
+      printf("%s: Command not found\n", argv[0]);
+      return -1;
+  }
+  if((pid = launch(path, argv, pgid, io, childmask)) < 0 &&
+     io->nredirs > 0 && access(path, X_OK) == 0)
+  {
+      /* posix_spawn can't tell a bad redirection from a bad program;
+       * a forked child opens the files itself and names the culprit */
+      pid = launch_fork(path, argv, pgid, io, childmask);
+  }
+  if(pid < 0)
+  {
+      printf("%s: Command not found\n", argv[0]);
+      return -1;
+  }
+  return pid;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// launch_pipeline - Start every stage in one process group, each
+// stage's stdout piped into the next one's stdin and then redirected
+// as the stage says. If outfd is not -1 it is every stage's stderr
+// and the last one's stdout; if place is not NULL every stage runs
+// where it says. Fills in pids[] and
+// returns how many processes were started; the first is the group
+// leader. A stage that cannot be started is skipped and its
+// neighbours see EOF / EPIPE.
+//
+int launch_pipeline(char ***stagev, int nstages, const struct redir_t *redirs,
+                    const int *stageredir, int outfd, const struct place_t *place,
+                    const sigset_t *childmask, pid_t *pids)
+{
+  struct childio_t io = { { -1, -1, -1 }, NULL, 0, place };
+  int *fds = io.fds;
+  int pfd[2], in = -1, n = 0, i;
+  long long t0 = 0;
+  pid_t pid;
+
+  fds[2] = outfd;
+  for(i = 0; i < nstages; i++)
+  {
+      fds[0] = in;
+      fds[1] = outfd;
+      io.redirs = redirs + stageredir[i];
+      io.nredirs = stageredir[i + 1] - stageredir[i];
+      if(i < nstages - 1)
+      {
+          /* O_CLOEXEC: each child keeps only the ends dup'ed onto 0/1 */
+          if(pipe2(pfd, O_CLOEXEC) < 0)
+          {
+              printf("pipe error: %s \n", strerror(errno));
+              break;
+          }
+          fds[1] = pfd[1];
+      }
+
+      if(trace_on)
+      {
+          t0 = trace_now();
+          trace(TR_SPAWN, 0, 0, 0);
+      }
+      pid = launch_stage(stagev[i], n > 0 ? pids[0] : 0, &io, childmask,
+                         nstages > 1);
+      if(trace_on && pid > 0)
+      {
+          hist_add(&hist_spawn, trace_now() - t0);
+          trace(TR_EXEC, pid, 0, trace_now() - t0);
+      }
+      if(in >= 0)
+      {
+          close(in);
+      }
+      in = -1;
+      if(i < nstages - 1)
+      {
+          close(pfd[1]);
+          in = pfd[0];
+      }
+      if(pid > 0)
+      {
+          pids[n++] = pid;
+      }
+  }
+  if(in >= 0)
+  {
+      close(in);
+  }
+  return n;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// The builtin commands (struct builtin_t, above)
+//
+static const struct builtin_t builtins[] = {
+  { "quit", do_quit, B_REDIR },
+  { "jobs", do_jobs, B_REDIR },
+  { "bg", do_bgfg, 0 },
+  { "fg", do_bgfg, 0 },
+  { "hash", do_hash, B_REDIR },
+  { "output", do_output, B_REDIR },  //without following, when redirected
+  { "limit", do_limit, 0 },
+  { "parallel", do_parallel, B_INFILE },  //parallel cmd < inputs
+  { "stats", do_stats, B_REDIR },
+  { "deadline", do_deadline, B_REDIR },
+  { "history", do_history, B_REDIR },
+  { "after", do_after, 0 },
+  { "affinity", do_affinity, B_REDIR },
+  { "nice", do_nice, B_JOBARG | B_REDIR },  //nice with anything else is nice(1)
+};
+
+//
+// builtin_lookup - The builtin argv runs, or NULL if it is not one
+//
+static const struct builtin_t *builtin_lookup(char **argv)
+{
+  const struct builtin_t *b;
+
+  for(b = builtins; b < builtins + sizeof(builtins) / sizeof(builtins[0]); b++)
+  {
+      if(strcmp(argv[0], b->name) == 0)
+      {
+          if((b->flags & B_JOBARG) && (argv[1] == NULL || argv[1][0] != '%'))
+          {
+              return NULL;
+          }
+          return b;
+      }
+  }
+  return NULL;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// builtin_cmd - If the user has typed a built-in command then execute
+// it immediately. The command name would be in argv[0] and
+// is a C string. We've cast this to a C++ string type to simplify
+// string comparisons; however, the do_bgfg routine will need 
+// to use the argv array as well to look for a job number.
+// If inshell is set (a foreground command on its own) the native
+// utilities (echo, true, false, sleep, kill) run here too instead of
+// in a child; otherwise they are left to launch_stage.
+//
+int builtin_cmd(char **argv, int inshell) 
+{
+        const struct builtin_t *b;
+        utilfn_t *fn;
+
+        if((b = builtin_lookup(argv)) != NULL)
+        {
+            b->fn(argv);
+            return 1;
+        }
+
+        else if (inshell && (fn = util_lookup(argv[0])) != NULL)
+        {
+            if(fn == sleep_main)
+            {
+                do_sleep(argv);
+            }
+            else
+            {
+                lastexit = fn(argv);
+            }
+            return 1;
+        }
+        
+        else
+        {
+            return 0;     /* not a builtin command */
+        }
+}
+
+//
+// do_quit, do_jobs - Execute the builtin quit and jobs [-l] commands
+//
+void do_quit(char **argv)
+{
+        exit(0);
+}
+
+void do_jobs(char **argv)
+{
+        listjobs(&jobs, argv[1] != NULL && strcmp(argv[1], "-l") == 0);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// print_time - Report what a "time"d command used, in the style of
+// bash's time keyword plus peak memory and context switches.
+//
+void print_time(const struct jobstats_t *ts)
+{
+        const struct rusage *ru = &ts->ru;
+        double real = (ts->end.tv_sec - ts->start.tv_sec) +
+                      (ts->end.tv_nsec - ts->start.tv_nsec) / 1e9;
+        double user = ru->ru_utime.tv_sec + ru->ru_utime.tv_usec / 1e6;
+        double sys = ru->ru_stime.tv_sec + ru->ru_stime.tv_usec / 1e6;
+
+        printf("\nreal\t%dm%.3fs\n", (int)(real / 60), real - 60 * (int)(real / 60));
+        printf("user\t%dm%.3fs\n", (int)(user / 60), user - 60 * (int)(user / 60));
+        printf("sys\t%dm%.3fs\n", (int)(sys / 60), sys - 60 * (int)(sys / 60));
+        printf("maxrss\t%ld KB\n", ru->ru_maxrss);
+        printf("ctxsw\t%ld voluntary, %ld involuntary\n", ru->ru_nvcsw, ru->ru_nivcsw);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// do_bgfg - Execute the builtin bg and fg commands
+//
+void do_bgfg(char **argv) 
+{
+	struct job_t *job = NULL;
+        pid_t pid;
+        int jid;
+ 
+        /* Fetch the job to be worked on, by %jobid or PID */
+        if((job = jobarg(argv)) == NULL)
+        {
+            lastexit = 1;
+            return;
+        }
+ 
+        if(job->state == WA)
+        {
+            printf("%%%d: waiting for the jobs it runs after\n", job->jid);
+            lastexit = 1;
+            return;
+        }
+
+        /* A queued job has no processes yet: start it now, in the
+         * background or the foreground, regardless of the job limit */
+        if(job->state == QU)
+        {
+            if((job = startqueued(job, strcmp("bg", argv[0]) == 0 ? BG : FG)) != NULL &&
+               job->state == FG)
+            {
+                waitfg(job->pid);
+            }
+            return;
+        }
+
+        /* Set pid and jid to that of the job to be worked on. */
+        pid = job->pid;
+        jid = job->jid;
+ 
+        /* The following if-else statements perform actions on the job based on the command entered. */
+        if(strcmp("bg", argv[0]) == 0) 
+        {
+            /* Command entered was BG. If job's state is stopped, continue in the background. */
+            if(job->state == ST) 
+            {
+                if(killjob(&jobs, job, SIGCONT) < 0) 
+                {
+                    printf("An error has occurred in kill. \n");
+                }
+                    setjobstate(&jobs, job, BG);
+                    printf("[%d] (%d) %s", jid, pid, job->cmdline);
+            }
+                
+                else
+                {
+                    printf("This job is already running in the background. \n");
+                    return;
+                }
+        }
+        
+        else
+        {
+            if(killjob(&jobs, job, SIGCONT) < 0) 
+            {
+                printf("An error has occurred in kill. \n");
+            }
+                setjobstate(&jobs, job, FG);
+                waitfg(pid); //wait until pid is no longer associated with FG
+        }
+        
+        return;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// do_hash - Execute the builtin hash command
+//
+//   hash           list the cached command paths
+//   hash -r        forget them
+//   hash name ...  look the names up on $PATH and cache them
+//
+void do_hash(char **argv)
+{
+        int i;
+
+        if(argv[1] == NULL)
+        {
+            pathcache_list();
+            return;
+        }
+
+        if(strcmp(argv[1], "-r") == 0)
+        {
+            pathcache_reset();
+            return;
+        }
+
+        for(i = 1; argv[i] != NULL; i++)
+        {
+            if(pathcache_lookup(argv[i]) == NULL)
+            {
+                printf("hash: %s: not found \n", argv[i]);
+            }
+        }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// do_sleep - Run sleep inside the shell. The event loop keeps running
+// while it waits, and ctrl-c ends it early. ctrl-z hands the rest of
+// the sleep to a child and stops that, so it becomes a stopped job
+// like an external sleep would, ready for fg or bg.
+//
+void do_sleep(char **argv)
+{
+        struct timespec ts, deadline, now;
+        char left[32], line[64];
+        char *rest[] = { argv[0], left, NULL };
+        long ms;
+        pid_t pid;
+
+        if(sleep_parse(argv, &ts) < 0)
+        {
+            return;
+        }
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += ts.tv_sec + (deadline.tv_nsec + ts.tv_nsec) / 1000000000;
+        deadline.tv_nsec = (deadline.tv_nsec + ts.tv_nsec) % 1000000000;
+
+        fgsig = 0;
+        for(;;)
+        {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            ms = (deadline.tv_sec - now.tv_sec) * 1000 +
+                 (deadline.tv_nsec - now.tv_nsec + 999999) / 1000000;
+            if(ms <= 0)
+            {
+                return;
+            }
+            if(fgsig == SIGINT || fgsig == SIGTSTP)
+            {
+                lastexit = 128 + fgsig;
+                fgintr = 1;
+            }
+            if(fgsig == SIGINT)
+            {
+                return;
+            }
+            if(fgsig == SIGTSTP)
+            {
+                break;
+            }
+            ev_wait(ms);
+        }
+
+        snprintf(left, sizeof(left), "%ld.%03lds", ms / 1000, ms % 1000);
+        snprintf(line, sizeof(line), "%s %s\n", argv[0], left);
+        fflush(stdout);
+        if((pid = launch_func(sleep_main, rest, 0, NULL, &childmask)) > 0 &&
+           addjob(&jobs, pid, BG, line))
+        {
+            watchjob(getjobpid(&jobs, pid));
+            kill(pid, SIGTSTP);  /* sigchld_handler reports the stop */
+        }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// do_output - Execute the builtin output command
+//
+//   output %jobid|pid       print what a job has written so far (the
+//                           last OUTRING bytes of it); tsh -o only
+//   output %jobid|pid -f    ... and keep printing until the job is
+//                           done or ctrl-c (not when redirected: that
+//                           takes the event loop)
+//
+void do_output(char **argv)
+{
+        struct job_t *job;
+        struct outring_t *r;
+
+        if((job = jobarg(argv)) == NULL)
+        {
+            lastexit = 1;
+            return;
+        }
+        if((r = job->info->out) == NULL)
+        {
+            printf("%s: output of job [%d] is not captured (see tsh -o)\n",
+                   argv[0], job->jid);
+            return;
+        }
+
+        if(outring_start(r) > 0)
+        {
+            printf("[%llu bytes dropped]\n", outring_start(r));
+        }
+        followpos = outring_print(r, 0, stdout);
+        if(argv[2] == NULL || strcmp(argv[2], "-f") != 0 || shellredir)
+        {
+            return;
+        }
+
+        /* releaseoutput prints the last of it and clears following */
+        following = job;
+        fgsig = 0;
+        while(following != NULL && fgsig == 0)
+        {
+            fflush(stdout);
+            ev_wait(-1);
+            if(following != NULL)
+            {
+                followpos = outring_print(r, followpos, stdout);
+            }
+        }
+        following = NULL;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// do_limit - Execute the builtin limit command
+//
+//   limit            show the job limit
+//   limit jobs N     run at most N jobs at once (0: no limit); more
+//                    background jobs wait in a queue, shown as Queued
+//                    by jobs, and start in order as running ones end
+//
+void do_limit(char **argv)
+{
+        char *end;
+        long n;
+
+        if(argv[1] == NULL)
+        {
+            if(joblimit > 0)
+            {
+                printf("jobs %d\n", joblimit);
+            }
+            else
+            {
+                printf("jobs unlimited\n");
+            }
+            return;
+        }
+        if(strcmp(argv[1], "jobs") != 0 || argv[2] == NULL ||
+           (n = strtol(argv[2], &end, 10)) < 0 || *end != '\0' || end == argv[2])
+        {
+            printf("%s: usage: %s [jobs N]\n", argv[0], argv[0]);
+            return;
+        }
+        joblimit = (int)n;
+        admit();  //a higher limit may free slots right away
+}
+
+/* putbyte - Add c to a command line, inside single quotes if quote */
+static inline size_t putbyte(char *buf, size_t len, char c, int quote)
+{
+        if(quote && c == '\'')  //end the quote, \', start again
+        {
+            memcpy(buf + len, "'\\''", 4);
+            return len + 4;
+        }
+        buf[len] = c;
+        return len + 1;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// addword - Append word to the command line in *buf (length len, room
+//     *cap), with each {} in it replaced by arg, quoted so that parsecmd
+//     gives back the same word. Returns the new length.
+//
+static size_t addword(char **buf, size_t *cap, size_t len, const char *word,
+                      const char *arg)
+{
+        const char *p, *q;
+        size_t need;
+        int quote;
+
+        need = len + 4 * (strlen(word) + strlen(arg) + 2);
+        for(p = word; (p = strstr(p, "{}")) != NULL; p += 2)
+        {
+            need += 4 * strlen(arg);
+        }
+        if(need > *cap)
+        {
+            *cap = 2 * need;
+            if((*buf = (char *)realloc(*buf, *cap)) == NULL)
+            {
+                app_error("parallel: out of memory");
+            }
+        }
+
+        quote = (*word == '\0' || strpbrk(word, " \t\n'\"\\|&;<>()") != NULL ||
+                 (strstr(word, "{}") != NULL &&
+                  (*arg == '\0' || strpbrk(arg, " \t\n'\"\\|&;<>()") != NULL)));
+        if(len > 0)
+        {
+            (*buf)[len++] = ' ';
+        }
+        if(quote)
+        {
+            (*buf)[len++] = '\'';
+        }
+        for(p = word; *p != '\0'; p++)
+        {
+            if(p[0] == '{' && p[1] == '}')
+            {
+                for(q = arg; *q != '\0'; q++)
+                {
+                    len = putbyte(*buf, len, *q, quote);
+                }
+                p++;
+            }
+            else
+            {
+                len = putbyte(*buf, len, *p, quote);
+            }
+        }
+        if(quote)
+        {
+            (*buf)[len++] = '\'';
+        }
+        return len;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// do_parallel - Execute the builtin parallel command
+//
+//   parallel [-j N] cmd [arg ...] ::: input ...
+//   parallel [-j N] cmd [arg ...] < inputs
+//
+// Runs cmd once per input (one per word after :::, else one per line
+// of stdin), with {} in its words replaced by the input, or the input
+// added as a last argument if there is no {}. N jobs (default: one per
+// CPU) run at a time as background jobs; a slot is refilled as soon as
+// its job is reaped. At the end it reports the total wall clock and
+// CPU time used. ctrl-c stops it and passes the SIGINT to the jobs.
+//
+void do_parallel(char **argv)
+{
+        static struct cmd_t cmd;  //not eval's, which holds argv
+        static char *line;        //one instance of the command
+        static size_t linecap;
+        struct partab_t tab;
+        struct jobstats_t ts;
+        struct job_t *job;
+        char **tmpl, **inputs = NULL, *in = NULL, *p, *end;
+        size_t len, inlen = 0, incap = 0;
+        int ninputs = 0, next, i, hasbraces = 0, savecapture, readin, fd;
+        ssize_t n;
+        long nj;
+
+        memset(&tab, 0, sizeof(tab));
+        tab.nslots = (int)sysconf(_SC_NPROCESSORS_ONLN);
+        tmpl = argv + 1;
+        if(tmpl[0] != NULL && strcmp(tmpl[0], "-j") == 0)
+        {
+            if(tmpl[1] == NULL || (nj = strtol(tmpl[1], &end, 10)) < 1 ||
+               *end != '\0')
+            {
+                printf("%s: -j needs a number of jobs, 1 or more\n", argv[0]);
+                return;
+            }
+            tab.nslots = (int)nj;
+            tmpl += 2;
+        }
+        if(tab.nslots < 1)
+        {
+            tab.nslots = 1;
+        }
+        for(i = 0; tmpl[i] != NULL && strcmp(tmpl[i], ":::") != 0; i++)
+        {
+            hasbraces |= (strstr(tmpl[i], "{}") != NULL);
+        }
+        if(i == 0)
+        {
+            printf("%s: usage: %s [-j N] command [arg ...] [::: input ...]\n",
+                   argv[0], argv[0]);
+            return;
+        }
+        if(tmpl[i] != NULL)  //the inputs follow :::
+        {
+            tmpl[i] = NULL;
+            inputs = tmpl + i + 1;
+            for(ninputs = 0; inputs[ninputs] != NULL; ninputs++)
+                ;
+        }
+        else  //one input per line of stdin
+        {
+            /* Commands piped into the shell: the inputs are the lines
+             * after this one, which readcmd may have read ahead. Else
+             * the "< file", or stdin itself (a terminal, or the shell's
+             * own when it runs tsh -f or -c). */
+            readin = builtinin < 0 && stdincmds && !isatty(STDIN_FILENO);
+            fd = builtinin >= 0 ? builtinin : STDIN_FILENO;
+            for(;;)
+            {
+                p = readin ? readcmd() : NULL;
+                len = p != NULL ? strlen(p) : 0;
+                if(inlen + len + 4096 > incap)
+                {
+                    incap = 2 * (inlen + len + 4096);
+                    if((in = (char *)realloc(in, incap)) == NULL)
+                    {
+                        app_error("parallel: out of memory");
+                    }
+                }
+                if(readin)
+                {
+                    if(p == NULL)
+                    {
+                        break;
+                    }
+                    memcpy(in + inlen, p, len);
+                    inlen += len;
+                    continue;
+                }
+                if((n = read(fd, in + inlen, incap - inlen - 1)) <= 0)
+                {
+                    if(n < 0 && errno == EINTR)
+                    {
+                        continue;
+                    }
+                    break;
+                }
+                inlen += n;
+            }
+            if(in != NULL)
+            {
+                in[inlen] = '\0';
+                if((inputs = (char **)malloc((inlen / 2 + 2) * sizeof(char *))) == NULL)
+                {
+                    app_error("parallel: out of memory");
+                }
+                for(p = in; p < in + inlen; p = end + 1)
+                {
+                    if((end = strchr(p, '\n')) == NULL)
+                    {
+                        end = in + inlen;
+                    }
+                    *end = '\0';
+                    if(end > p)  //blank lines are no input
+                    {
+                        inputs[ninputs++] = p;
+                    }
+                }
+            }
+        }
+
+        if((tab.slots = (pid_t *)calloc(tab.nslots, sizeof(pid_t))) == NULL)
+        {
+            app_error("parallel: out of memory");
+        }
+        memset(&ts, 0, sizeof(ts));
+        clock_gettime(CLOCK_REALTIME, &ts.start);
+
+        /* The jobs' output is the command's output, not something to
+         * keep for later, even under tsh -o */
+        savecapture = capture;
+        capture = 0;
+        par = &tab;
+        fgsig = 0;
+        for(next = 0; next < ninputs || tab.busy > 0; )
+        {
+            while(next < ninputs && tab.busy < tab.nslots && fgsig != SIGINT)
+            {
+                len = 0;
+                for(i = 0; tmpl[i] != NULL; i++)
+                {
+                    len = addword(&line, &linecap, len, tmpl[i], inputs[next]);
+                }
+                if(!hasbraces)
+                {
+                    len = addword(&line, &linecap, len, "{}", inputs[next]);
+                }
+                memcpy(line + len, "\n", 2);
+                next++;
+                if(parsecmd(line, &cmd) <= 0 ||
+                   (job = runjob(&cmd, line, NULL, BG)) == NULL)
+                {
+                    tab.done++;
+                    tab.failed++;
+                    continue;
+                }
+                for(i = 0; tab.slots[i] != 0; i++)
+                    ;
+                tab.slots[i] = job->pid;
+                tab.busy++;
+            }
+            if(fgsig == SIGINT)
+            {
+                next = ninputs;  //start nothing more
+                for(i = 0; i < tab.nslots; i++)
+                {
+                    if(tab.slots[i] != 0 && (job = getjobpid(&jobs, tab.slots[i])) != NULL)
+                    {
+                        killjob(&jobs, job, SIGINT);
+                    }
+                }
+                fgsig = 0;
+            }
+            if(tab.busy > 0)
+            {
+                fflush(stdout);
+                ev_wait(-1);
+            }
+        }
+        par = NULL;
+        capture = savecapture;
+        clock_gettime(CLOCK_REALTIME, &ts.end);
+        ts.ru = tab.ru;
+
+        printf("%s: %d jobs, %d failed, %d at a time\n", argv[0], tab.done,
+               tab.failed, tab.nslots);
+        print_time(&ts);
+        {
+            double real = (ts.end.tv_sec - ts.start.tv_sec) +
+                          (ts.end.tv_nsec - ts.start.tv_nsec) / 1e9;
+            double cpu = ts.ru.ru_utime.tv_sec + ts.ru.ru_utime.tv_usec / 1e6 +
+                         ts.ru.ru_stime.tv_sec + ts.ru.ru_stime.tv_usec / 1e6;
+
+            printf("cpu/real\t%.2f\n", real > 0 ? cpu / real : 0.0);
+        }
+        free(tab.slots);
+        if(in != NULL)
+        {
+            free(inputs);
+            free(in);
+        }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// pardone - A job has been reaped (with the wait status of its last
+//     member). If it is one of parallel's, free its slot and count it.
+//
+void pardone(struct job_t *job, int status)
+{
+        int i;
+
+        for(i = 0; i < par->nslots && par->slots[i] != job->pid; i++)
+            ;
+        if(i == par->nslots)
+        {
+            return;  //some other background job
+        }
+        par->slots[i] = 0;
+        par->busy--;
+        par->done++;
+        if(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        {
+            par->failed++;
+        }
+        addrusage(&par->ru, &job->info->stats.ru);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// do_stats - Execute the builtin stats command (tsh -v only)
+//
+//   stats            event counts, and the spawn and fg latency
+//                    histograms (see trace.h)
+//   stats -d [file]  write the traced events as JSON lines to file,
+//                    or to stdout
+//   stats -r         forget the events and empty the histograms
+//
+void do_stats(char **argv)
+{
+        FILE *fp;
+
+        if(!trace_on)
+        {
+            printf("%s: nothing traced (start tsh with -v)\n", argv[0]);
+            return;
+        }
+        if(argv[1] == NULL)
+        {
+            trace_print(stdout);
+        }
+        else if(strcmp(argv[1], "-r") == 0)
+        {
+            trace_reset();
+        }
+        else if(strcmp(argv[1], "-d") == 0 && argv[2] == NULL)
+        {
+            trace_dump(stdout);
+        }
+        else if(strcmp(argv[1], "-d") == 0)
+        {
+            if((fp = fopen(argv[2], "w")) == NULL)
+            {
+                printf("%s: %s: %s\n", argv[0], argv[2], strerror(errno));
+                return;
+            }
+            printf("%zu events written to %s\n", trace_dump(fp), argv[2]);
+            fclose(fp);
+        }
+        else
+        {
+            printf("%s: usage: %s [-d [file] | -r]\n", argv[0], argv[0]);
+        }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// do_deadline - Execute the builtin deadline command
+//
+//   deadline %jobid|pid          show how long the job has left
+//   deadline %jobid|pid DUR      kill the job DUR (1.5, 30s, 2m, ...)
+//                                from now; 0 cancels its deadline
+//
+// When a deadline passes the job's process group gets SIGTERM, and
+// SIGKILL KILLGRACE ms later if it is still around.
+//
+void do_deadline(char **argv)
+{
+        struct job_t *job;
+        long long left;
+        double secs;
+
+        if((job = jobarg(argv)) == NULL)
+        {
+            lastexit = 1;
+            return;
+        }
+
+        if(argv[2] == NULL)
+        {
+            if((left = tw_left(&job->info->deadline)) < 0)
+            {
+                printf("[%d] (%d) no deadline\n", job->jid, job->pid);
+            }
+            else
+            {
+                printf("[%d] (%d) %lld.%03llds left before SIG%s\n", job->jid, job->pid,
+                       left / 1000, left % 1000, sigabbrev_np(job->info->deadsig));
+            }
+            return;
+        }
+        if(dur_parse(argv[2], &secs) < 0)
+        {
+            printf("%s: invalid time interval '%s'\n", argv[0], argv[2]);
+            return;
+        }
+        setdeadline(job, secs > 0 && secs < 0.001 ? 1 : (long long)(secs * 1000));
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// do_history - Execute the builtin history command
+//
+//   history            every entry, numbered
+//   history N          the last N entries
+//   history -s text    the entries containing text
+//   history -p text    the distinct entries starting with text
+//
+// The history is shared by every interactive tsh (see history.h);
+// !!, !N, !-N and !prefix at the start of a line rerun an entry.
+//
+void do_history(char **argv)
+{
+        if(!history_on)
+        {
+            printf("%s: not enabled (interactive shells, or set TSH_HISTFILE)\n", argv[0]);
+            return;
+        }
+        if(argv[1] == NULL)
+        {
+            history_print(0, stdout);
+        }
+        else if(isdigit(argv[1][0]) && argv[2] == NULL)
+        {
+            history_print(strtoul(argv[1], NULL, 10), stdout);
+        }
+        else if((strcmp(argv[1], "-s") == 0 || strcmp(argv[1], "-p") == 0) &&
+                argv[2] != NULL && argv[3] == NULL)
+        {
+            history_search(argv[2], argv[1][1], stdout);
+        }
+        else
+        {
+            printf("%s: usage: %s [N | -s text | -p text]\n", argv[0], argv[0]);
+        }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// do_after - Execute the builtin after command
+//
+//   after %jobid... -- command    run command in the background once
+//                                 every job named has exited 0
+//   after -f file                 the same for each line of file:
+//                                     name: [dep ...] -- command
+//                                 where a dep is another line's name
+//                                 or a %jobid (# starts a comment)
+//   after                         show the graph
+//
+// The jobs it makes wait in the job list in state WA; each is started
+// (or queued, at the job limit) by dagrun as soon as the last job it
+// runs after is reaped, and dropped if one of them fails. When every
+// job in the graph is done the makespan and critical path are
+// reported. Shell operators in command need quoting, and a single
+// word is taken as the whole command line: after %1 -- 'sort f | uniq'.
+//
+void do_after(char **argv)
+{
+        char *line = NULL;
+        size_t len = 0, cap = 0;
+        struct job_t *job, *dep;
+        int i, dd, n;
+
+        if(argv[1] == NULL)
+        {
+            daglist();
+            return;
+        }
+        if(strcmp(argv[1], "-f") == 0)
+        {
+            if(argv[2] == NULL || argv[3] != NULL)
+            {
+                printf("%s: usage: %s -f file\n", argv[0], argv[0]);
+                lastexit = 1;
+                return;
+            }
+            afterfile(argv[2]);
+            dagrun();
+            return;
+        }
+
+        for(dd = 1; argv[dd] != NULL && strcmp(argv[dd], "--") != 0; dd++)
+        {
+            if(argv[dd][0] != '%' || getjobjid(&jobs, atoi(&argv[dd][1])) == NULL)
+            {
+                printf("%s: No such job\n", argv[dd]);
+                lastexit = 1;
+                return;
+            }
+        }
+        if(dd == 1 || argv[dd] == NULL || argv[dd + 1] == NULL)
+        {
+            printf("%s: usage: %s %%jobid... -- command [arg ...]\n", argv[0], argv[0]);
+            lastexit = 1;
+            return;
+        }
+
+        if(argv[dd + 2] == NULL)  //one word: a command line of its own
+        {
+            len = strlen(argv[dd + 1]);
+            if((line = (char *)malloc(len + 2)) == NULL)
+            {
+                app_error("after: out of memory");
+            }
+            memcpy(line, argv[dd + 1], len);
+        }
+        else
+        {
+            for(i = dd + 1; argv[i] != NULL; i++)
+            {
+                len = addword(&line, &cap, len, argv[i], "{}");
+            }
+        }
+        line[len++] = '\n';
+        line[len] = '\0';
+
+        if((job = newjob(&jobs, line)) != NULL)
+        {
+            setjobstate(&jobs, job, WA);
+            n = dagadd(job);
+            for(i = 1; i < dd; i++)
+            {
+                dep = getjobjid(&jobs, atoi(&argv[i][1]));
+                dagedge(dagadd(dep), n);
+            }
+            printf("[%d] (waiting) %s", job->jid, job->cmdline);
+        }
+        free(line);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// afterfile - Read an after -f file into the graph. Every line is
+//     checked, and the names resolved and checked for cycles, before
+//     any job is made.
+//
+struct afterline_t {
+  char *name;
+  char **deps;              //names and %jobids
+  int ndeps;
+  char *cmd;                //the rest of the line, from the "--" on
+  int node;                 //its node in the graph, once made
+  int nwait;                //for the cycle check
+};
+
+static void afterfile(const char *file)
+{
+        struct afterline_t *al = NULL;
+        char *buf = NULL, *p, *q, *word;
+        size_t bufcap = 0;
+        ssize_t r;
+        int n = 0, cap = 0, lineno = 0, i, j, k, m, ok = 0, *order = NULL, nord;
+        struct job_t *job, *dep;
+        FILE *fp;
+
+        if((fp = fopen(file, "r")) == NULL)
+        {
+            printf("after: %s: %s\n", file, strerror(errno));
+            lastexit = 1;
+            return;
+        }
+
+        /* name: [dep ...] -- command */
+        while((r = getline(&buf, &bufcap, fp)) >= 0)
+        {
+            lineno++;
+            if(r > 0 && buf[r - 1] != '\n')  //a last line without its newline
+            {
+                if((size_t)r + 2 > bufcap &&
+                   (buf = (char *)realloc(buf, bufcap = r + 2)) == NULL)
+                {
+                    app_error("after: out of memory");
+                }
+                strcpy(buf + r, "\n");
+            }
+            for(p = buf; isspace((unsigned char)*p); p++)
+                ;
+            if(*p == '\0' || *p == '#')
+            {
+                continue;
+            }
+            if(n == cap)
+            {
+                cap = cap ? 2 * cap : 16;
+                if((al = (struct afterline_t *)realloc(al, cap * sizeof(*al))) == NULL)
+                {
+                    app_error("after: out of memory");
+                }
+            }
+            memset(&al[n], 0, sizeof(al[n]));
+            if((q = strstr(p, " -- ")) == NULL && (q = strstr(p, "\t-- ")) == NULL)
+            {
+                printf("after: %s:%d: no \" -- command\"\n", file, lineno);
+                goto done;
+            }
+            al[n].cmd = strdup(q + 4);
+            *q = '\0';
+            if((q = strchr(p, ':')) == NULL || q == p)
+            {
+                printf("after: %s:%d: no \"name:\"\n", file, lineno);
+                n++;
+                goto done;
+            }
+            *q++ = '\0';
+            al[n].name = strdup(strtok(p, " \t"));
+            al[n].deps = (char **)malloc((strlen(q) / 2 + 1) * sizeof(char *));
+            for(word = strtok(q, " \t"); word != NULL; word = strtok(NULL, " \t"))
+            {
+                al[n].deps[al[n].ndeps++] = strdup(word);
+            }
+            n++;
+        }
+
+        /* Resolve the names; count each line's dependencies on others */
+        for(i = 0; i < n; i++)
+        {
+            for(j = 0; j < i; j++)
+            {
+                if(strcmp(al[i].name, al[j].name) == 0)
+                {
+                    printf("after: %s: %s is defined twice\n", file, al[i].name);
+                    goto done;
+                }
+            }
+            for(k = 0; k < al[i].ndeps; k++)
+            {
+                if(al[i].deps[k][0] == '%')
+                {
+                    if(getjobjid(&jobs, atoi(&al[i].deps[k][1])) == NULL)
+                    {
+                        printf("after: %s: %s: No such job\n", file, al[i].deps[k]);
+                        goto done;
+                    }
+                    continue;
+                }
+                for(j = 0; j < n && strcmp(al[i].deps[k], al[j].name) != 0; j++)
+                    ;
+                if(j == n)
+                {
+                    printf("after: %s: %s needs %s, which is not there\n", file,
+                           al[i].name, al[i].deps[k]);
+                    goto done;
+                }
+                al[i].nwait++;
+            }
+        }
+
+        /* Kahn's algorithm: whatever cannot be ordered is on a cycle */
+        order = (int *)malloc((n + 1) * sizeof(int));
+        for(i = nord = 0; i < n; i++)
+        {
+            if(al[i].nwait == 0)
+            {
+                order[nord++] = i;
+            }
+        }
+        for(k = 0; k < nord; k++)
+        {
+            for(i = 0; i < n; i++)
+            {
+                for(j = 0; j < al[i].ndeps; j++)
+                {
+                    if(strcmp(al[i].deps[j], al[order[k]].name) == 0 && --al[i].nwait == 0)
+                    {
+                        order[nord++] = i;
+                    }
+                }
+            }
+        }
+        if(nord < n)
+        {
+            for(i = 0; al[i].nwait == 0; i++)
+                ;
+            printf("after: %s: %s is on a dependency cycle\n", file, al[i].name);
+            goto done;
+        }
+
+        /* Make the jobs, each after those it needs */
+        for(k = 0; k < n; k++)
+        {
+            i = order[k];
+            if((job = newjob(&jobs, al[i].cmd)) == NULL)
+            {
+                break;
+            }
+            setjobstate(&jobs, job, WA);
+            al[i].node = dagadd(job);
+            for(j = 0; j < al[i].ndeps; j++)
+            {
+                if(al[i].deps[j][0] == '%')
+                {
+                    dep = getjobjid(&jobs, atoi(&al[i].deps[j][1]));
+                    dagedge(dagadd(dep), al[i].node);
+                    continue;
+                }
+                for(m = 0; strcmp(al[i].deps[j], al[m].name) != 0; m++)
+                    ;
+                dagedge(al[m].node, al[i].node);
+            }
+            if(al[i].ndeps == 0)
+            {
+                dagstart(al[i].node);
+            }
+            else
+            {
+                printf("[%d] (waiting) %s", job->jid, job->cmdline);
+            }
+        }
+        ok = 1;
+
+ done:
+        if(!ok)
+        {
+            lastexit = 1;
+        }
+        for(i = 0; i < n; i++)
+        {
+            for(j = 0; j < al[i].ndeps; j++)
+            {
+                free(al[i].deps[j]);
+            }
+            free(al[i].deps);
+            free(al[i].name);
+            free(al[i].cmd);
+        }
+        free(al);
+        free(order);
+        free(buf);
+        fclose(fp);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// dagadd - The node of job in the after graph, added (as running, or
+//     as waiting if the job is WA) if it has none
+//
+static int dagadd(struct job_t *job)
+{
+        struct dagnode_t *n;
+
+        if(job->info->dagnode != 0)
+        {
+            return job->info->dagnode - 1;
+        }
+        if(dag == NULL && (dag = (struct dag_t *)calloc(1, sizeof(struct dag_t))) == NULL)
+        {
+            app_error("after: out of memory");
+        }
+        if(dag->n == dag->cap)
+        {
+            dag->cap = dag->cap ? 2 * dag->cap : 16;
+            dag->nodes = (struct dagnode_t *)realloc(dag->nodes, dag->cap * sizeof(struct dagnode_t));
+            if(dag->nodes == NULL)
+            {
+                app_error("after: out of memory");
+            }
+        }
+        n = &dag->nodes[dag->n];
+        memset(n, 0, sizeof(*n));
+        n->job = job;
+        n->jid = job->jid;
+        n->text = strdup(job->cmdline);
+        n->state = job->state == WA ? DAG_WAIT : DAG_RUN;
+        n->via = -1;
+        dag->live++;
+        job->info->dagnode = ++dag->n;
+        return dag->n - 1;
+}
+
+//
+// dagedge - Node to waits for node from
+//
+static void dagedge(int from, int to)
+{
+        struct dagnode_t *f = &dag->nodes[from];
+
+        if(f->nsucc == f->succcap)
+        {
+            f->succcap = f->succcap ? 2 * f->succcap : 4;
+            if((f->succ = (int *)realloc(f->succ, f->succcap * sizeof(int))) == NULL)
+            {
+                app_error("after: out of memory");
+            }
+        }
+        f->succ[f->nsucc++] = to;
+        dag->nodes[to].nwait++;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// dagnote - jobs.dropped: a job is leaving the job list. If it is in
+//     the after graph, note how it did; dagrun acts on it once the job
+//     list is done with the job.
+//
+void dagnote(struct job_t *job)
+{
+        struct dagnode_t *n;
+        int st = job->info->status;
+
+        if(job->info->dagnode == 0 || dag == NULL)
+        {
+            return;
+        }
+        n = &dag->nodes[job->info->dagnode - 1];
+        job->info->dagnode = 0;
+        n->job = NULL;
+        n->ran = job->pid != 0;
+        n->start = job->info->stats.start;
+        n->end = job->info->stats.end;
+        if(!n->ran || n->end.tv_sec == 0)
+        {
+            clock_gettime(CLOCK_REALTIME, &n->end);
+        }
+        n->state = n->ran && job->nlive == 0 && job->info->termsig == 0 &&
+                   WIFEXITED(st) && WEXITSTATUS(st) == 0 ? DAG_OK : DAG_FAIL;
+        dag->live--;
+        dag->dirty = 1;
+}
+
+//
+// dagstart - Start node i's job now, or queue it at the job limit
+//
+static void dagstart(int i)
+{
+        struct dagnode_t *n = &dag->nodes[i];
+        struct job_t *job = n->job;
+
+        n->state = DAG_RUN;
+        if(jobs.qhead != NULL ||
+           (joblimit > 0 && jobs.nstate[BG] + jobs.nstate[FG] >= joblimit))
+        {
+            queuejob(&jobs, job);
+        }
+        else
+        {
+            startqueued(job, BG);  //on failure dagnote hears of it
+        }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// dagrun - Pass on what the jobs that finished since the last call did:
+//     start each waiting job whose last predecessor has succeeded, and
+//     drop those with one that failed (and so on down the graph).
+//     Report and forget the graph once all of it is done.
+//
+void dagrun(void)
+{
+        struct dagnode_t *n, *m;
+        struct job_t *job;
+        int i, k;
+
+        if(dag == NULL || !dag->dirty)
+        {
+            return;
+        }
+        while(dag->dirty)
+        {
+            dag->dirty = 0;
+            for(i = 0; i < dag->n; i++)
+            {
+                n = &dag->nodes[i];
+                if(n->told || n->state == DAG_WAIT || n->state == DAG_RUN)
+                {
+                    continue;
+                }
+                n->told = 1;
+                for(k = 0; k < n->nsucc; k++)
+                {
+                    m = &dag->nodes[n->succ[k]];
+                    if(m->state != DAG_WAIT)
+                    {
+                        continue;
+                    }
+                    if(n->state == DAG_OK)
+                    {
+                        if(--m->nwait == 0)
+                        {
+                            m->via = i;
+                            dagstart(n->succ[k]);
+                        }
+                        continue;
+                    }
+                    printf("Job [%d] not run: job [%d] %s\n", m->jid, n->jid,
+                           n->state == DAG_SKIP ? "was not run" : "did not succeed");
+                    job = m->job;
+                    job->info->dagnode = 0;
+                    dropjob(&jobs, job);
+                    m->job = NULL;
+                    m->state = DAG_SKIP;
+                    clock_gettime(CLOCK_REALTIME, &m->end);
+                    dag->live--;
+                    dag->dirty = 1;
+                }
+            }
+        }
+        if(dag->live == 0)
+        {
+            dagreport();
+            for(i = 0; i < dag->n; i++)
+            {
+                free(dag->nodes[i].succ);
+                free(dag->nodes[i].text);
+            }
+            free(dag->nodes);
+            free(dag);
+            dag = NULL;
+        }
+}
+
+//
+// dagsecs - b - a in seconds
+//
+static double dagsecs(const struct timespec *a, const struct timespec *b)
+{
+        return (b->tv_sec - a->tv_sec) + (b->tv_nsec - a->tv_nsec) / 1e9;
+}
+
+//
+// dagreport - The whole graph is done: how long it took from the first
+//     start to the last end (makespan), and the chain of jobs, each
+//     started by the one before, that ended last (critical path)
+//
+static void dagreport(void)
+{
+        struct dagnode_t *n, *first = NULL, *last = NULL;
+        int i, k, nfail = 0, nskip = 0, *chain;
+        double cp = 0;
+
+        for(i = 0; i < dag->n; i++)
+        {
+            n = &dag->nodes[i];
+            nfail += n->state == DAG_FAIL;
+            nskip += n->state == DAG_SKIP;
+            if(!n->ran)
+            {
+                continue;
+            }
+            if(first == NULL || dagsecs(&n->start, &first->start) > 0)
+            {
+                first = n;
+            }
+            if(last == NULL || dagsecs(&last->end, &n->end) > 0)
+            {
+                last = n;
+            }
+        }
+        printf("after: %d jobs, %d failed, %d not run", dag->n, nfail, nskip);
+        if(last == NULL)
+        {
+            printf("\n");
+            return;
+        }
+        if((chain = (int *)malloc(dag->n * sizeof(int))) == NULL)
+        {
+            app_error("after: out of memory");
+        }
+        for(k = 0, i = last - dag->nodes; i >= 0; i = dag->nodes[i].via)
+        {
+            chain[k++] = i;
+            cp += dagsecs(&dag->nodes[i].start, &dag->nodes[i].end);
+        }
+        printf("; makespan %.3fs, critical path %.3fs:\n",
+               dagsecs(&first->start, &last->end), cp);
+        while(k-- > 0)
+        {
+            n = &dag->nodes[chain[k]];
+            printf("    [%d] %8.3fs  %s", n->jid, dagsecs(&n->start, &n->end), n->text);
+        }
+        free(chain);
+}
+
+//
+// daglist - after with no arguments: the graph so far
+//
+static void daglist(void)
+{
+        static const char *statename[] = { "waiting", "running", "done", "failed", "not run" };
+        struct dagnode_t *n;
+        int i;
+
+        if(dag == NULL)
+        {
+            printf("after: no jobs\n");
+            return;
+        }
+        for(i = 0; i < dag->n; i++)
+        {
+            n = &dag->nodes[i];
+            printf("[%d] %-7s", n->jid, statename[n->state]);
+            if(n->state == DAG_WAIT)
+            {
+                printf(" (%d to go)", n->nwait);
+            }
+            printf(" %s", n->text);
+        }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// jobgone - jobs.dropped: a job is leaving the job list, so its CPU
+//     is free again and the after graph hears how it did
+//
+static void jobgone(struct job_t *job)
+{
+        if(job->info->cpu != 0)
+        {
+            place_release(job->info->cpu - 1);
+        }
+        dagnote(job);
+}
+
+//
+// jobarg - The job argv[1] names, by %jobid or PID; NULL after saying
+//     why if there is none
+//
+static struct job_t *jobarg(char **argv)
+{
+        struct job_t *job;
+
+        if(argv[1] == NULL)
+        {
+            printf("%s command requires PID or %%jobid argument\n", argv[0]);
+            return NULL;
+        }
+        if(argv[1][0] == '%')
+        {
+            if((job = getjobjid(&jobs, atoi(&argv[1][1]))) == NULL)
+            {
+                printf("%s: No such job\n", argv[1]);
+            }
+            return job;
+        }
+        if(isdigit(argv[1][0]))
+        {
+            if((job = getjobpid(&jobs, atoi(argv[1]))) == NULL)
+            {
+                printf("(%s): No such process\n", argv[1]);
+            }
+            return job;
+        }
+        printf("%s: argument must be a PID or %%jobid\n", argv[0]);
+        return NULL;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// do_affinity - Execute the builtin affinity command
+//
+//   affinity %jobid|pid          show the CPUs the job runs on
+//   affinity %jobid|pid CPUS     pin it to CPUS (0-3,8, ...)
+//
+// Every process of a running job is moved at once; a queued or
+// waiting job starts on CPUS. Either way the CPU tsh -a gave it, if
+// any, is free for the next job.
+//
+void do_affinity(char **argv)
+{
+        struct job_t *job;
+        cpu_set_t set;
+        char buf[256];
+        int i, err = 0;
+
+        if((job = jobarg(argv)) == NULL)
+        {
+            lastexit = 1;
+            return;
+        }
+        if(argv[2] == NULL)
+        {
+            if(job->pid == 0)
+            {
+                printf("[%d] (-) cpus %s\n", job->jid, (job->info->place.flags & PL_CPUS) ?
+                       cpus_format(&job->info->place.cpus, buf, sizeof(buf)) : "-");
+            }
+            else if(sched_getaffinity(job->pid, sizeof(set), &set) < 0)
+            {
+                printf("%s: (%d) %s\n", argv[0], job->pid, strerror(errno));
+                lastexit = 1;
+            }
+            else
+            {
+                printf("[%d] (%d) cpus %s\n", job->jid, job->pid,
+                       cpus_format(&set, buf, sizeof(buf)));
+            }
+            return;
+        }
+        if(argv[3] != NULL || cpus_parse(argv[2], &set) < 0)
+        {
+            printf("%s: invalid CPU list '%s'\n", argv[0], argv[2]);
+            lastexit = 1;
+            return;
+        }
+
+        /* The leader (which may be reaped before the rest: ESRCH), then
+         * the members not yet reaped, whose PIDs cannot have been reused */
+        if(job->pid != 0 && sched_setaffinity(job->pid, sizeof(set), &set) < 0 &&
+           errno != ESRCH)
+        {
+            err = errno;
+        }
+        for(i = 0; job->pid != 0 && i < job->info->nprocs - 1 && err == 0; i++)
+        {
+            if(getjobpid(&jobs, job->info->pids[i]) == job &&
+               sched_setaffinity(job->info->pids[i], sizeof(set), &set) < 0)
+            {
+                err = errno;
+            }
+        }
+        if(err != 0)
+        {
+            printf("%s: (%d) %s\n", argv[0], job->pid, strerror(err));
+            lastexit = 1;
+            return;
+        }
+        job->info->place.cpus = set;
+        job->info->place.flags |= PL_CPUS;
+        if(job->info->cpu != 0)
+        {
+            place_release(job->info->cpu - 1);
+            job->info->cpu = 0;
+        }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// do_nice - Execute the builtin nice command
+//
+//   nice %jobid          show the job's nice value
+//   nice %jobid N        set it to N (-20 to 19; lower needs privilege)
+//
+// A running job's whole process group is reniced; a queued or waiting
+// job starts at N. Without a %jobid, nice is the nice program.
+//
+void do_nice(char **argv)
+{
+        struct job_t *job;
+        char *end;
+        long n;
+
+        if((job = jobarg(argv)) == NULL)
+        {
+            lastexit = 1;
+            return;
+        }
+        if(argv[2] == NULL)
+        {
+            if(job->pid == 0)
+            {
+                if(job->info->place.flags & PL_NICE)
+                {
+                    printf("[%d] (-) nice %d\n", job->jid, job->info->place.nice);
+                }
+                else
+                {
+                    printf("[%d] (-) nice -\n", job->jid);
+                }
+                return;
+            }
+            errno = 0;
+            n = getpriority(PRIO_PGRP, job->pid);
+            if(errno != 0)
+            {
+                printf("%s: (%d) %s\n", argv[0], job->pid, strerror(errno));
+                lastexit = 1;
+                return;
+            }
+            printf("[%d] (%d) nice %ld\n", job->jid, job->pid, n);
+            return;
+        }
+        n = strtol(argv[2], &end, 10);
+        if(argv[3] != NULL || end == argv[2] || *end != '\0' || n < -20 || n > 19)
+        {
+            printf("%s: usage: %s %%jobid [N], -20 <= N <= 19\n", argv[0], argv[0]);
+            lastexit = 1;
+            return;
+        }
+        if(job->pid != 0 && setpriority(PRIO_PGRP, job->pid, n) < 0)
+        {
+            printf("%s: (%d) %s\n", argv[0], job->pid, strerror(errno));
+            lastexit = 1;
+            return;
+        }
+        job->info->place.nice = n;
+        job->info->place.flags |= PL_NICE;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// setdeadline - Have job killed ms milliseconds from now, replacing
+//     any deadline it had; 0 just cancels it
+//
+void setdeadline(struct job_t *job, long long ms)
+{
+        tw_del(&job->info->deadline);
+        if(ms > 0)
+        {
+            job->info->deadsig = SIGTERM;
+            if(tw_add(&job->info->deadline, ms, deadline_event, job) < 0)
+            {
+                printf("deadline: %s\n", strerror(errno));
+            }
+        }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// deadline_event - A job's deadline has passed: SIGTERM it (waking it
+//     up if stopped, so it can act on it) and give it KILLGRACE ms to
+//     go before the SIGKILL. Deleting the job disarms the timer.
+//
+void deadline_event(struct wtimer_t *t, void *arg)
+{
+        struct job_t *job = (struct job_t *)arg;
+
+        if(job->info->deadsig == SIGTERM)
+        {
+            printf("Job [%d] (%d) timed out\n", job->jid, job->pid);
+            if(job->state == QU || job->state == WA)  //never started: killjob just drops it
+            {
+                killjob(&jobs, job, SIGTERM);
+                dagrun();
+                return;
+            }
+            killjob(&jobs, job, SIGTERM);
+            if(job->state == ST)
+            {
+                killjob(&jobs, job, SIGCONT);
+            }
+            job->info->deadsig = SIGKILL;
+            tw_add(t, KILLGRACE, deadline_event, job);
+        }
+        else
+        {
+            killjob(&jobs, job, SIGKILL);
+        }
+        fflush(stdout);
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// waitfg - Block until process pid is no longer the foreground process
+//wait until given pid is no longer associated with fg job
+// (reaped or stopped). Woken by SIGCHLD rather than by polling.
+void waitfg(pid_t pid)
+{
+        /* A captured job brought to the foreground shows its output
+         * as it comes, as if it were not captured */
+        if(jobs.fg != NULL && jobs.fg->info->out != NULL)
+        {
+            following = jobs.fg;
+            followpos = following->info->out->head;
+        }
+
+        /* Run the event loop until sigchld_handler (or anything else)
+         * has reaped or stopped the job. */
+        while(fgpid(&jobs) == pid)
+        {
+            ev_wait(-1);
+            if(following != NULL)
+            {
+                followpos = outring_print(following->info->out, followpos, stdout);
+                fflush(stdout);
+            }
+        }
+        following = NULL;
+
+        return;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// Signal handlers
+//
+// These are no longer installed with Signal(). The signals are kept
+// blocked and read from a signalfd by signal_event, which calls the
+// matching handler from the event loop, so the handlers may use printf
+// and change the job list without racing the rest of the shell.
+//
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// signal_event - Drain the signalfd in one batch. Repeats of a signal
+//     are coalesced: one sigchld_handler call reaps every child that
+//     has changed state.
+//
+void signal_event(int fd, unsigned events, void *arg)
+{
+	struct signalfd_siginfo si[16];
+        int chld = 0, intr = 0, tstp = 0, quit = 0;
+        ssize_t n, i;
+
+        while((n = read(fd, si, sizeof(si))) > 0)
+        {
+            for(i = 0; i < n / (ssize_t)sizeof(si[0]); i++)
+            {
+                trace(TR_SIGNAL, si[i].ssi_pid, 0, si[i].ssi_signo);
+                switch(si[i].ssi_signo)
+                {
+                case SIGCHLD: chld = 1; break;
+                case SIGINT:  intr = 1; break;
+                case SIGTSTP: tstp = 1; break;
+                case SIGQUIT: quit = 1; break;
+                }
+            }
+        }
+
+        if(quit)
+        { sigquit_handler(SIGQUIT); }
+        if(intr)
+        { sigint_handler(SIGINT); }
+        if(tstp)
+        { sigtstp_handler(SIGTSTP); }
+        if(chld)
+        { sigchld_handler(SIGCHLD); }
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// watchjob - Open a pidfd (procfd.h) for every process of a new job
+//     and add it to the event loop, which calls child_event when the
+//     process exits. If one can't be had or watched, pidfds are
+//     given up for good and sigchld_handler goes back to reaping
+//     every child itself (the ones already watched included).
+//
+void watchjob(struct job_t *job)
+{
+        pid_t pid;
+        int i, fd;
+
+        for(i = 0; pidfd_ok && i < job->info->nprocs; i++)
+        {
+            pid = i == 0 ? job->pid : job->info->pids[i - 1];
+            if((fd = procfd_open(pid)) < 0)
+            {
+                pidfd_ok = 0;
+                break;
+            }
+            if(ev_add(fd, EPOLLIN, child_event, (void *)(intptr_t)pid) < 0)
+            {
+                close(fd);
+                pidfd_ok = 0;
+                break;
+            }
+            setpidfd(&jobs, pid, fd);
+        }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// child_event - A watched child has exited: reap it through its pidfd
+//
+void child_event(int fd, unsigned events, void *arg)
+{
+        struct rusage ru;
+        int status;
+        pid_t pid;
+
+        if((pid = procfd_reap(fd, &status, &ru)) > 0)
+        {
+            childdone(pid, status, &ru);
+        }
+        else if(pid < 0) //gone without us; don't leave the pidfd readable forever
+        {
+            childdone((pid_t)(intptr_t)arg, 0, NULL);
+        }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// output_event - A captured job has written something (or closed its
+//     end of the pipe): move it into the job's ring buffer
+//
+void output_event(int fd, unsigned events, void *arg)
+{
+        struct job_t *job = (struct job_t *)arg;
+        struct outring_t *r = job->info->out;
+
+        if(!outring_fill(r))
+        {
+            ev_del(fd);
+            close(fd);
+            r->fd = -1;
+        }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// releaseoutput - The job is done: take in what is left in its pipe,
+//     show it if someone is following the job, and free the buffer
+//
+void releaseoutput(struct job_t *job)
+{
+        struct outring_t *r = job->info->out;
+
+        if(r == NULL)
+        {
+            return;
+        }
+        if(r->fd >= 0)
+        {
+            outring_fill(r);
+            ev_del(r->fd);
+        }
+        if(job == following)
+        {
+            followpos = outring_print(r, followpos, stdout);
+            following = NULL;
+        }
+        outring_free(r);
+        job->info->out = NULL;
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// childstopped - Process pid was stopped by signal sig
+//
+void childstopped(pid_t pid, int sig)
+{
+        struct job_t *job;
+
+        if((job = getjobpid(&jobs, pid)) == NULL) // match PID w/ its job
+        {
+            return;
+        }
+        /* Every stage of a pipeline stops; report the job once */
+        if(job->state != ST)
+        {
+            if(job->state == FG)
+            {
+                lastexit = 128 + sig;
+                fgintr = 1;
+            }
+            printf("Job [%d] (%d) stopped by signal %d\n", job->jid, job->pid, sig);
+            setjobstate(&jobs, job, ST);
+            admit();  //a stopped job no longer counts against the limit
+        }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// childdone - Process pid has been reaped with the given wait status
+//     and resource use. Deletes its job once every member is done.
+//
+void childdone(pid_t pid, int status, const struct rusage *ru)
+{
+        struct job_t *job;
+        int fd;
+
+        if((job = getjobpid(&jobs, pid)) == NULL) // match PID w/ its job
+        {
+            return;
+        }
+        trace(TR_REAP, pid, job->jid, status);
+        if((fd = getpidfd(&jobs, pid)) >= 0)
+        {
+            ev_del(fd);
+            close(fd);
+            setpidfd(&jobs, pid, -1);
+        }
+        if(WIFSIGNALED(status) && WTERMSIG(status) != SIGPIPE)
+        {   //child terminated by a signal that was not caught; an
+            //upstream stage dying of SIGPIPE is routine, not news
+            job->info->termsig = WTERMSIG(status);
+        }
+        if(pid == (job->info->nprocs > 1 ? job->info->pids[job->info->nprocs - 2] : job->pid))
+        {   //a pipeline's status is its last stage's
+            job->info->status = status;
+        }
+        if(reapjobpid(&jobs, job, pid, ru) == 0) // last member reaped
+        {
+            if(job->state == FG) //kept for the "time" keyword, and && and ||
+            {
+                fgstats = job->info->stats;
+                fgstats_pid = job->pid;
+                status = job->info->status;
+                lastexit = WIFSIGNALED(status) ? 128 + WTERMSIG(status) : WEXITSTATUS(status);
+                fgintr = job->info->termsig == SIGINT;
+            }
+            releaseoutput(job);
+            if(par != NULL)
+            {
+                pardone(job, status);
+            }
+            if(job->info->termsig)
+            {
+                printf("Job [%d] (%d) terminated by signal %d\n", job->jid, job->pid, job->info->termsig);
+            }
+            deletejob(&jobs, job->pid);
+            admit();
+            dagrun();
+        }
+}
+
+/////////////////////////////////////////////////////////////////////////////
+//
+// sigchld_handler - The kernel sends a SIGCHLD to the shell whenever
+//     a child job terminates (becomes a zombie), or stops because it
+//     received a SIGSTOP or SIGTSTP signal. Exits are left to the
+//     children's pidfds (child_event), so this only collects stops:
+//     waitid without WEXITED never reaps anything. Without pidfds it
+//     reaps all available zombies too, but doesn't wait for any other
+//     currently running children to terminate.
 //
 void sigchld_handler(int sig) 
 {
-	int pid, jid, status;
-        struct job_t *fgjob = NULL;
-         //waitpid(-1) means wait set consists of all the parent's child processes
-        while((pid = waitpid(-1, &status, WNOHANG|WUNTRACED)) > 0) //return immediately,
+	int pid, status;
+        struct rusage ru;
+        siginfo_t si;
+
+        if(pidfd_ok)
+        {
+            for(;;)
+            {
+                si.si_pid = 0;
+                if(waitid(P_ALL, 0, &si, WSTOPPED|WNOHANG) < 0 || si.si_pid == 0)
+                {
+                    break;
+                }
+                childstopped(si.si_pid, si.si_status);
+            }
+            return;
+        }
+
+         //wait4(-1) means wait set consists of all the parent's child processes;
+         //it is waitpid plus the reaped child's resource usage
+        while((pid = wait4(-1, &status, WNOHANG|WUNTRACED, &ru)) > 0) //return immediately,
         {   //with a return value of 0 if none of the children in wait set has stopped or
             //terminated. OR with a return val equal to the PID of one of the stopped or 
             //terminated children
-            jid = pid2jid(pid); // match PID w/ JID
             if(WIFSTOPPED(status)) //returns True if child is stopped
             {
-                printf("Job [%d] (%d) stopped by signal %d. \n", jid, pid, sig);
-                fgjob = getjobpid(jobs, pid);
-                fgjob->state = ST;
+                childstopped(pid, WSTOPSIG(status));
             }
-            else if(deletejob(jobs, pid))  // reaped here
+            else
             {
-               if(WIFSIGNALED(status)) //returns true if child process terminated by
-               {                       //signal that was not caught
-                   printf("Job [%d] (%d) terminated by signal %d \n", jid, pid, sig);
-               }
+                childdone(pid, status, &ru);
             }
         }
         
@@ -419,15 +3661,17 @@ void sigchld_handler(int sig)
 //
 void sigint_handler(int sig) 
 {
-	pid_t pid = 0;
- 
-        if((pid = fgpid(jobs)) > 0) // if there is child w/ PID = pid in wait set
+        if(jobs.fg != NULL) // if there is a foreground job
         {
-            if(kill(-pid, sig) < 0) // if kill is unsuccessful
+            if(killjob(&jobs, jobs.fg, sig) < 0) // if kill is unsuccessful
             {
                 printf("An error has occurred in kill. \n");
             }
         }
+        else
+        {
+            fgsig = sig;  // for a builtin running in the shell (do_sleep)
+        }
         
         return;
 }
@@ -441,15 +3685,17 @@ void sigint_handler(int sig)
 //
 void sigtstp_handler(int sig) 
 {
-	pid_t pid = 0;
- 
-        if((pid = fgpid(jobs)) > 0) 
+        if(jobs.fg != NULL) 
         {
-            if(kill(-pid, sig) < 0)
+            if(killjob(&jobs, jobs.fg, sig) < 0)
             {
                 printf("An error has occurred in kill. \n");
             }
         }
+        else
+        {
+            fgsig = sig;
+        }
         
         return;
 }
@@ -0,0 +1,374 @@
+/*
+ * tshbench.c - End-to-end benchmarks for the tiny shell
+ *
+ * usage: tshbench [-n <iters>] [-s <shell>] [-m <MB>] fg|spawn|script|cat
+ *
+ * fg   Foreground turnaround. Runs the shell with a prompt on a pair
+ *      of pipes, sends "/bin/true" <iters> times and times each
+ *      command from the write until the next "tsh> " prompt comes
+ *      back, once with the shell's native true and once with "tsh -n"
+ *      so it runs the real /bin/true. The same command is also run
+ *      directly with fork/execv/waitpid so the shell's own overhead
+ *      can be read off the difference.
+ *
+ * spawn Launch throughput. Starts and reaps /bin/true <iters> times
+ *      with each of the shell's launch methods (posix_spawn,
+ *      fork/execv and the zygote), first as-is and then after growing
+ *      this process by <MB> megabytes of touched heap (default 256)
+ *      to stand in for a shell with a large address space. The
+ *      zygote is started before the heap grows, as tsh -z does.
+ *
+ * script Batch throughput. Writes scripts of <iters> lines, one of
+ *      the builtin "jobs" and one of "/bin/true", and runs each with
+ *      "tsh -f" and, for comparison, fed to "tsh -p" on stdin.
+ *      Reports lines per second.
+ *
+ * cat  Bulk copies. Writes a <MB>-megabyte file and has the shell run
+ *      "cat file > copy" (file to file) and "cat file | cat >
+ *      /dev/null" (file to pipe) <iters> times, with the native cat
+ *      (copy_file_range / sendfile / splice) and with "tsh -n" so the
+ *      real cat does it. Reports MB/s.
+ *
+ * Results are printed one per line as "<name> key=value ..." so
+ * they can be collected by scripts.
+ */
+#include <stdio.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "launch.h"
+
+static const char *shell = "./tsh";
+static int iters = 1000;
+static int heap_mb = 256;
+
+/* now_ns - monotonic clock in nanoseconds */
+static long long now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int cmp_ll(const void *a, const void *b)
+{
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+/* report - sort the samples and print min/median/p99/mean in usecs */
+static void report(const char *name, long long *ns, int n)
+{
+    long long sum = 0;
+    int i;
+
+    qsort(ns, n, sizeof(ns[0]), cmp_ll);
+    for (i = 0; i < n; i++)
+	sum += ns[i];
+    printf("%s n=%d min_us=%.1f median_us=%.1f p99_us=%.1f mean_us=%.1f\n",
+	   name, n, ns[0] / 1e3, ns[n / 2] / 1e3, ns[(n * 99) / 100] / 1e3,
+	   (double)sum / n / 1e3);
+}
+
+/*
+ * wait_prompt - read from fd until the shell's "tsh> " prompt has
+ *    been seen. Returns 0 on success, -1 on EOF.
+ */
+static int wait_prompt(int fd)
+{
+    static const char prompt[] = "tsh> ";
+    size_t matched = 0;
+    char buf[512];
+    ssize_t n, i;
+
+    for (;;) {
+	if ((n = read(fd, buf, sizeof(buf))) <= 0)
+	    return -1;
+	for (i = 0; i < n; i++) {
+	    if (buf[i] == prompt[matched])
+		matched++;
+	    else
+		matched = (buf[i] == prompt[0]);
+	    if (matched == sizeof(prompt) - 1) {
+		if (i == n - 1)
+		    return 0;
+		matched = 0;
+	    }
+	}
+    }
+}
+
+/* bench_direct - fork/execv/waitpid /bin/true with no shell involved */
+static void bench_direct(long long *ns)
+{
+    char *argv[] = { (char *)"/bin/true", NULL };
+    long long t0;
+    pid_t pid;
+    int i;
+
+    for (i = 0; i < iters; i++) {
+	t0 = now_ns();
+	if ((pid = fork()) == 0) {
+	    execv(argv[0], argv);
+	    _exit(127);
+	}
+	waitpid(pid, NULL, 0);
+	ns[i] = now_ns() - t0;
+    }
+    report("direct_true", ns, iters);
+}
+
+/* bench_fg - time "/bin/true" through the shell, prompt to prompt;
+ *    opt, if not NULL, is an option for the shell */
+static void bench_fg(long long *ns, const char *name, const char *opt)
+{
+    static const char cmd[] = "/bin/true\n";
+    int in[2], out[2];
+    long long t0;
+    pid_t pid;
+    int i;
+
+    if (pipe(in) < 0 || pipe(out) < 0) {
+	perror("pipe");
+	exit(1);
+    }
+    if ((pid = fork()) == 0) {
+	dup2(in[0], 0);
+	dup2(out[1], 1);
+	close(in[0]); close(in[1]);
+	close(out[0]); close(out[1]);
+	execl(shell, shell, opt, (char *)NULL);
+	perror(shell);
+	_exit(1);
+    }
+    close(in[0]);
+    close(out[1]);
+
+    if (wait_prompt(out[0]) < 0) {
+	fprintf(stderr, "%s: no prompt from shell\n", shell);
+	exit(1);
+    }
+    for (i = 0; i < iters; i++) {
+	t0 = now_ns();
+	if (write(in[1], cmd, sizeof(cmd) - 1) < 0 || wait_prompt(out[0]) < 0) {
+	    fprintf(stderr, "%s: shell went away\n", shell);
+	    exit(1);
+	}
+	ns[i] = now_ns() - t0;
+    }
+    close(in[1]);
+    waitpid(pid, NULL, 0);
+    close(out[0]);
+    report(name, ns, iters);
+}
+
+/* spawn_rate - spawns/sec of /bin/true with one launch method */
+static void spawn_rate(const char *name, int mode, int mb)
+{
+    char *argv[] = { (char *)"/bin/true", NULL };
+    sigset_t mask;
+    long long t0, ns;
+    pid_t pid;
+    int i;
+
+    sigprocmask(SIG_SETMASK, NULL, &mask);
+    launch_mode = mode;
+    t0 = now_ns();
+    for (i = 0; i < iters; i++) {
+	if ((pid = launch(argv[0], argv, 0, NULL, &mask)) < 0) {
+	    perror("launch");
+	    exit(1);
+	}
+	waitpid(pid, NULL, 0);
+    }
+    ns = now_ns() - t0;
+    printf("%s heap_mb=%d n=%d spawns_per_sec=%.0f us_per_spawn=%.1f\n",
+	   name, mb, iters, iters / (ns / 1e9), ns / 1e3 / iters);
+}
+
+/* bench_spawn - posix_spawn vs fork, before and after growing the heap */
+static void bench_spawn(void)
+{
+    size_t len = (size_t)heap_mb << 20;
+    char *heap;
+
+    if (zygote_start() < 0) {
+	perror("zygote_start");
+	exit(1);
+    }
+    spawn_rate("spawn_posix", LAUNCH_SPAWN, 0);
+    spawn_rate("spawn_fork", LAUNCH_FORK, 0);
+    spawn_rate("spawn_zygote", LAUNCH_ZYGOTE, 0);
+
+    if ((heap = (char *)malloc(len)) == NULL) {
+	perror("malloc");
+	exit(1);
+    }
+    memset(heap, 1, len); /* touch every page so fork has to copy its tables */
+    spawn_rate("spawn_posix", LAUNCH_SPAWN, heap_mb);
+    spawn_rate("spawn_fork", LAUNCH_FORK, heap_mb);
+    spawn_rate("spawn_zygote", LAUNCH_ZYGOTE, heap_mb);
+    free(heap);
+}
+
+/* script_rate - lines/sec of a <lines>-line script run by the shell */
+static void script_rate(const char *name, const char *file, int lines,
+			int use_f)
+{
+    long long t0, ns;
+    pid_t pid;
+    int fd;
+
+    t0 = now_ns();
+    if ((pid = fork()) == 0) {
+	if ((fd = open("/dev/null", O_WRONLY)) >= 0)
+	    dup2(fd, 1);
+	if (use_f)
+	    execl(shell, shell, "-f", file, (char *)NULL);
+	else {
+	    if ((fd = open(file, O_RDONLY)) >= 0)
+		dup2(fd, 0);
+	    execl(shell, shell, "-p", (char *)NULL);
+	}
+	_exit(1);
+    }
+    waitpid(pid, NULL, 0);
+    ns = now_ns() - t0;
+    printf("%s mode=%s n=%d lines_per_sec=%.0f\n",
+	   name, use_f ? "file" : "stdin", lines, lines / (ns / 1e9));
+}
+
+/* bench_script - batch mode throughput for builtin and external lines */
+static void bench_script(void)
+{
+    static const char *cmds[] = { "jobs", "/bin/true" };
+    static const char *names[] = { "script_builtin", "script_true" };
+    char file[] = "/tmp/tshbenchXXXXXX";
+    FILE *fp;
+    int fd, i, c;
+
+    for (c = 0; c < 2; c++) {
+	if ((fd = mkstemp(file)) < 0 || (fp = fdopen(fd, "w")) == NULL) {
+	    perror("mkstemp");
+	    exit(1);
+	}
+	for (i = 0; i < iters; i++)
+	    fprintf(fp, "%s\n", cmds[c]);
+	fclose(fp);
+	script_rate(names[c], file, iters, 1);
+	script_rate(names[c], file, iters, 0);
+	unlink(file);
+	strcpy(file, "/tmp/tshbenchXXXXXX");
+    }
+}
+
+/* cat_rate - MB/s of the shell running cmd (which copies mb MB) */
+static void cat_rate(const char *name, const char *cmd, const char *opt, int mb)
+{
+    long long t0, ns;
+    pid_t pid;
+    int i;
+
+    t0 = now_ns();
+    for (i = 0; i < iters; i++) {
+	if ((pid = fork()) == 0) {
+	    if (opt != NULL)
+		execl(shell, shell, opt, "-c", cmd, (char *)NULL);
+	    else
+		execl(shell, shell, "-c", cmd, (char *)NULL);
+	    _exit(1);
+	}
+	waitpid(pid, NULL, 0);
+    }
+    ns = now_ns() - t0;
+    printf("%s n=%d mb=%d mb_per_sec=%.1f\n", name, iters, mb,
+	   (double)mb * iters / (ns / 1e9));
+}
+
+/* bench_cat - file-to-file and file-to-pipe copies by the shell's cat */
+static void bench_cat(void)
+{
+    char file[] = "/tmp/tshbenchXXXXXX", cmd[256];
+    static char buf[1 << 20];
+    int fd, i;
+
+    if ((fd = mkstemp(file)) < 0) {
+	perror("mkstemp");
+	exit(1);
+    }
+    memset(buf, 'x', sizeof(buf));
+    for (i = 0; i < heap_mb; i++)
+	if (write(fd, buf, sizeof(buf)) != (ssize_t)sizeof(buf)) {
+	    perror("write");
+	    exit(1);
+	}
+    close(fd);
+
+    snprintf(cmd, sizeof(cmd), "cat %s > %s.copy", file, file);
+    cat_rate("cat_file_to_file", cmd, NULL, heap_mb);
+    cat_rate("cat_file_to_file_external", cmd, "-n", heap_mb);
+    snprintf(cmd, sizeof(cmd), "cat %s | cat > /dev/null", file);
+    cat_rate("cat_file_to_pipe", cmd, NULL, heap_mb);
+    cat_rate("cat_file_to_pipe_external", cmd, "-n", heap_mb);
+
+    unlink(file);
+    strcat(file, ".copy");
+    unlink(file);
+}
+
+static void usage(const char *prog)
+{
+    fprintf(stderr, "Usage: %s [-n <iters>] [-s <shell>] [-m <MB>] "
+	    "fg|spawn|script|cat\n", prog);
+    exit(1);
+}
+
+int main(int argc, char **argv)
+{
+    long long *ns;
+    int c;
+
+    while ((c = getopt(argc, argv, "n:s:m:")) != EOF) {
+	switch (c) {
+	case 'n':
+	    iters = atoi(optarg);
+	    break;
+	case 's':
+	    shell = optarg;
+	    break;
+	case 'm':
+	    heap_mb = atoi(optarg);
+	    break;
+	default:
+	    usage(argv[0]);
+	}
+    }
+    if (optind != argc - 1 || iters < 1)
+	usage(argv[0]);
+
+    signal(SIGPIPE, SIG_IGN);
+    ns = (long long *)malloc(iters * sizeof(ns[0]));
+
+    if (strcmp(argv[optind], "fg") == 0) {
+	bench_direct(ns);
+	bench_fg(ns, "fg_true", NULL);
+	bench_fg(ns, "fg_true_external", "-n");
+    }
+    else if (strcmp(argv[optind], "spawn") == 0)
+	bench_spawn();
+    else if (strcmp(argv[optind], "script") == 0)
+	bench_script();
+    else if (strcmp(argv[optind], "cat") == 0)
+	bench_cat();
+    else
+	usage(argv[0]);
+
+    free(ns);
+    exit(0);
+}
@@ -0,0 +1,299 @@
+#include "utils.h"
+#include "jobs.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+
+/**************************************
+ * Native versions of small programs
+ **************************************/
+
+int util_external = 0;
+
+/* utilerr - Complain on stderr, after what is already on stdout */
+static void utilerr(const char *fmt, ...)
+{
+    va_list ap;
+
+    fflush(stdout);
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+}
+
+/*
+ * echo_main - coreutils echo: leading arguments made only of n, e and
+ *    E letters are options (-n: no newline, -e: interpret escapes,
+ *    -E: don't); with -e, \a \b \c \e \f \n \r \t \v \\, \0NNN, \NNN
+ *    and \xHH are understood, anything else is printed as typed.
+ */
+int echo_main(char **argv)
+{
+    int newline = 1, escapes = 0, i, c;
+    const char *s;
+
+    for (i = 1; argv[i] != NULL && argv[i][0] == '-' && argv[i][1] != '\0'; i++) {
+	for (s = argv[i] + 1; *s == 'n' || *s == 'e' || *s == 'E'; s++)
+	    ;
+	if (*s != '\0')
+	    break;		/* not an option after all */
+	for (s = argv[i] + 1; *s != '\0'; s++) {
+	    if (*s == 'n')
+		newline = 0;
+	    else
+		escapes = (*s == 'e');
+	}
+    }
+
+    for (; argv[i] != NULL; i++) {
+	if (!escapes)
+	    fputs(argv[i], stdout);
+	else {
+	    for (s = argv[i]; *s != '\0'; s++) {
+		if (*s != '\\' || s[1] == '\0') {
+		    putchar(*s);
+		    continue;
+		}
+		switch (c = *++s) {
+		case 'a': c = '\a'; break;
+		case 'b': c = '\b'; break;
+		case 'c': return 0;	/* no more output at all */
+		case 'e': c = '\033'; break;
+		case 'f': c = '\f'; break;
+		case 'n': c = '\n'; break;
+		case 'r': c = '\r'; break;
+		case 't': c = '\t'; break;
+		case 'v': c = '\v'; break;
+		case '\\': break;
+		case 'x':
+		    if (!isxdigit((unsigned char)s[1])) {
+			putchar('\\');
+			break;
+		    }
+		    c = 0;
+		    for (int n = 0; n < 2 && isxdigit((unsigned char)s[1]); n++) {
+			s++;
+			c = c * 16 + (isdigit((unsigned char)*s) ? *s - '0'
+				      : tolower((unsigned char)*s) - 'a' + 10);
+		    }
+		    break;
+		case '0': case '1': case '2': case '3':
+		case '4': case '5': case '6': case '7':
+		    /* \0 takes up to three more digits, \1-\7 two more */
+		    c -= '0';
+		    if (*s == '0' && s[1] >= '0' && s[1] <= '7')
+			c = *++s - '0';
+		    for (int n = 0; n < 2 && s[1] >= '0' && s[1] <= '7'; n++)
+			c = c * 8 + (*++s - '0');
+		    break;
+		default:
+		    putchar('\\');
+		    break;
+		}
+		putchar(c);
+	    }
+	}
+	if (argv[i + 1] != NULL)
+	    putchar(' ');
+    }
+    if (newline)
+	putchar('\n');
+    return 0;
+}
+
+int true_main(char **argv)
+{
+    return 0;
+}
+
+int false_main(char **argv)
+{
+    return 1;
+}
+
+/* dur_parse - One NUMBER[smhd] ("1.5", "2m") into seconds; -1 if bad */
+int dur_parse(const char *arg, double *secs)
+{
+    char *end;
+    double n = strtod(arg, &end);
+
+    if (end == arg || n < 0 || (*end != '\0' && end[1] != '\0'))
+	return -1;
+    switch (*end) {
+    case '\0': case 's': break;
+    case 'm': n *= 60; break;
+    case 'h': n *= 60 * 60; break;
+    case 'd': n *= 24 * 60 * 60; break;
+    default: return -1;
+    }
+    *secs = n;
+    return 0;
+}
+
+/* sleep_parse - "1.5", "2m", "1h 30m" (summed), as coreutils sleep */
+int sleep_parse(char **argv, struct timespec *ts)
+{
+    double secs = 0, n;
+    int i;
+
+    if (argv[1] == NULL) {
+	utilerr("%s: missing operand\n", argv[0]);
+	return -1;
+    }
+    for (i = 1; argv[i] != NULL; i++) {
+	if (dur_parse(argv[i], &n) < 0) {
+	    utilerr("%s: invalid time interval '%s'\n", argv[0], argv[i]);
+	    return -1;
+	}
+	secs += n;
+    }
+    ts->tv_sec = (time_t)secs;
+    ts->tv_nsec = (long)((secs - ts->tv_sec) * 1e9);
+    return 0;
+}
+
+int sleep_main(char **argv)
+{
+    struct timespec ts;
+
+    if (sleep_parse(argv, &ts) < 0)
+	return 1;
+    while (nanosleep(&ts, &ts) < 0 && errno == EINTR)
+	;
+    return 0;
+}
+
+/* signum - "INT", "SIGINT", "int" or "2" to a signal number; -1 if none */
+static int signum(const char *name)
+{
+    const char *abbrev;
+    char *end;
+    int sig;
+
+    if (isdigit((unsigned char)*name)) {
+	sig = strtol(name, &end, 10);
+	return (*end == '\0' && sig >= 0 && sig < NSIG) ? sig : -1;
+    }
+    if (strncasecmp(name, "SIG", 3) == 0)
+	name += 3;
+    for (sig = 1; sig < NSIG; sig++)
+	if ((abbrev = sigabbrev_np(sig)) != NULL && strcasecmp(name, abbrev) == 0)
+	    return sig;
+    return -1;
+}
+
+/*
+ * kill_main - kill [-s SIG | -n NUM | -SIG] pid|%jobid ...
+ *             kill -l [NUM]
+ *    A %jobid signals the job's whole process group (through a pidfd,
+ *    see killjob).
+ */
+int kill_main(char **argv)
+{
+    int sig = SIGTERM, i = 1, rc = 0, jid;
+    const char *arg, *abbrev;
+    struct job_t *job;
+    pid_t pid;
+    char *end;
+
+    if (argv[1] != NULL && strcmp(argv[1], "-l") == 0) {
+	if (argv[2] != NULL) {
+	    if ((sig = signum(argv[2])) <= 0) {
+		utilerr("%s: unknown signal: %s\n", argv[0], argv[2]);
+		return 1;
+	    }
+	    printf("%s\n", sigabbrev_np(sig));
+	    return 0;
+	}
+	for (sig = 1; sig < NSIG; sig++)
+	    if ((abbrev = sigabbrev_np(sig)) != NULL)
+		printf("%s%c", abbrev, sig % 8 == 0 ? '\n' : ' ');
+	printf("\n");
+	return 0;
+    }
+
+    if (argv[1] != NULL && argv[1][0] == '-' && strcmp(argv[1], "--") != 0) {
+	if (strcmp(argv[1], "-s") == 0 || strcmp(argv[1], "-n") == 0)
+	    arg = argv[i = 2];
+	else
+	    arg = argv[1] + 1;
+	if (arg == NULL || (sig = signum(arg)) < 0) {
+	    utilerr("%s: unknown signal: %s\n", argv[0], arg ? arg : "");
+	    return 1;
+	}
+	i++;
+    }
+    if (argv[i] != NULL && strcmp(argv[i], "--") == 0)
+	i++;
+    if (argv[i] == NULL) {
+	utilerr("%s: usage: %s [-s sigspec | -n signum | -sigspec] "
+		"pid | %%jobid ...\n", argv[0], argv[0]);
+	return 1;
+    }
+
+    for (; argv[i] != NULL; i++) {
+	if (argv[i][0] == '%') {
+	    jid = atoi(argv[i] + 1);
+	    if ((job = getjobjid(&jobs, jid)) == NULL) {
+		utilerr("%s: %s: no such job\n", argv[0], argv[i]);
+		rc = 1;
+		continue;
+	    }
+	    if (killjob(&jobs, job, sig) < 0) {
+		utilerr("%s: (%s) - %s\n", argv[0], argv[i], strerror(errno));
+		rc = 1;
+	    }
+	    continue;
+	}
+	else {
+	    pid = strtol(argv[i], &end, 10);
+	    if (end == argv[i] || *end != '\0') {
+		utilerr("%s: %s: arguments must be process or job IDs\n",
+			argv[0], argv[i]);
+		rc = 1;
+		continue;
+	    }
+	}
+	if (kill(pid, sig) < 0) {
+	    utilerr("%s: (%s) - %s\n", argv[0], argv[i],
+		    errno == ESRCH ? "No such process" : strerror(errno));
+	    rc = 1;
+	}
+    }
+    return rc;
+}
+
+/* The programs above, by name */
+static const struct {
+    const char *name;
+    utilfn_t *fn;
+} utils[] = {
+    { "echo", echo_main },
+    { "true", true_main },
+    { "false", false_main },
+    { "sleep", sleep_main },
+    { "kill", kill_main },
+    { NULL, NULL }
+};
+
+utilfn_t *util_lookup(const char *name)
+{
+    int i;
+
+    if (util_external)
+	return NULL;
+    /* only a bare name or the usual place; ./echo is someone else's */
+    if (strncmp(name, "/bin/", 5) == 0)
+	name += 5;
+    else if (strncmp(name, "/usr/bin/", 9) == 0)
+	name += 9;
+    for (i = 0; utils[i].name != NULL; i++)
+	if (strcmp(name, utils[i].name) == 0)
+	    return utils[i].fn;
+    return NULL;
+}
@@ -0,0 +1,38 @@
+//-*-c++-*-
+#ifndef _utils_h_
+#define _utils_h_
+
+#include <time.h>
+
+/*
+ * Native versions of small programs the traces and scripts run all
+ * the time. Each xxx_main(argv) behaves like the program of that name
+ * (echo and the rest as in coreutils, kill as in procps plus %jobid)
+ * and returns its exit status. The shell calls them directly for a
+ * foreground command and through launch_func otherwise, so they must
+ * also work in a forked child.
+ */
+int echo_main(char **argv);
+int true_main(char **argv);
+int false_main(char **argv);
+int sleep_main(char **argv);
+int kill_main(char **argv);
+
+typedef int utilfn_t(char **argv);
+
+/* util_lookup - The native version of name ("echo", "/bin/echo",
+ *    "/usr/bin/echo", ...), or NULL if there is none or util_external
+ *    is set. */
+utilfn_t *util_lookup(const char *name);
+
+/* sleep_parse - Sum sleep's NUMBER[smhd] arguments into *ts; -1 (after
+ *    saying why) if there are none or one is bad. */
+int sleep_parse(char **argv, struct timespec *ts);
+
+/* dur_parse - One NUMBER[smhd] argument ("1.5", "2m") in seconds; -1
+ *    (saying nothing) if it is not one. */
+int dur_parse(const char *arg, double *secs);
+
+extern int util_external;  // 1: always run the real programs (tsh -n)
+
+#endif